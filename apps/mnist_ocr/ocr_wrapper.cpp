@@ -37,7 +37,7 @@ public:
     {
         m_digit_ocr.process( img );
     }
-    const tinymage<float>& cropped_numbers()
+    const tinymage<unsigned char>& cropped_numbers()
     {
         return m_digit_ocr.cropped_numbers();
     }
@@ -66,14 +66,10 @@ void ocr_wrapper::process( emscripten::val image, emscripten::val onComplete )
 
     std::cout << "ocr_wrapper::process - " << sx << "x" << sy << " bytes @" << reinterpret_cast<int>( ptr ) << std::endl;
 
-    tinymage<float> img( sx, sy );
+    tinymage<float> img;
 
     // image pointer is RGBA formatted
-    size_t i=0;
-    img.apply( [&]( float& val ) {
-        val =  ptr[i] * 0.2126f + ptr[i+1] * 0.7152f + ptr[i+2] * 0.0722f;
-        i+=4;
-    });
+    img.ingest( ptr, sx, sy, tinymage_types::pixel_format::rgba, 0, 1, tinymage_types::auto_threads );
 
     //img.load( "./ocr/images/123456.png" );
     m_pimpl->process( img );
@@ -40,7 +40,7 @@ class digits_sign_detector
 {
 public:
     digits_sign_detector( size_t sx, size_t sy )
-		: m_img( sx, sy ), m_sign_helper( sx, sy ), m_digit_ocr_helper( tinydigit_base::model::caffe )
+		: m_img( sx, sy ), m_sign_helper( sx, sy, 0, 1 ), m_digit_ocr_helper( tinydigit_base::model::caffe )
     {
 		std::cout << "digits_sign_detector::digits_sign_detector - " << sx << "x" << sy << std::endl;
 	}
@@ -56,11 +56,7 @@ public:
         std::cout << "digits_sign_detector::process - " << sx << "x" << sy << " bytes @" << reinterpret_cast<int>( ptr ) << std::endl;
 
         // image pointer is RGBA formatted
-        size_t i=0;
-        m_img.apply( [&]( float& val ) {
-            val =  ptr[i] * 0.2126f + ptr[i+1] * 0.7152f + ptr[i+2] * 0.0722f;
-            i+=4;
-        });
+        m_img.ingest( ptr, sx, sy, tinymage_types::pixel_format::rgba, 0, 1, tinymage_types::auto_threads );
 
 		m_sign_helper.locate( m_img );
     }
@@ -0,0 +1,255 @@
+/*
+The MIT License
+
+Copyright (c) 2017-2017 Albert Murienne
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// tinymage operations timings, from digit patches to 4K frames, for float and 8 bits images
+// -> one csv line per operation, type and size on stdout :
+//    op,type,width,height,threads,iterations,min_ns_per_pixel,median_ns_per_pixel,mpixels_per_s,allocs_per_call,bytes_per_call
+// -> usage : bench_image [min_time_ms = 200] [nb_threads = 1, 0 for auto]
+
+#include "tiny_brain/tinymage.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// heap allocations of the whole process, sampled around the benchmarked calls
+static std::atomic<std::size_t> g_alloc_count{ 0 };
+static std::atomic<std::size_t> g_alloc_bytes{ 0 };
+
+void* operator new( std::size_t size )
+{
+    g_alloc_count.fetch_add( 1, std::memory_order_relaxed );
+    g_alloc_bytes.fetch_add( size, std::memory_order_relaxed );
+    if ( void* ptr = std::malloc( size ? size : 1 ) )
+        return ptr;
+    throw std::bad_alloc();
+}
+
+// kept out of line, or gcc takes the inlined new/delete pairs for malloc/delete mismatches
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete( void* ptr ) noexcept
+{
+    std::free( ptr );
+}
+
+void operator delete( void* ptr, std::size_t ) noexcept
+{
+    ::operator delete( ptr );
+}
+
+namespace {
+
+struct bench_config
+{
+    double min_time_ms = 200.;
+    std::size_t nb_threads = 1;
+};
+
+// results are read back so that the benchmarked calls cannot be optimized away
+volatile float g_sink = 0.f;
+
+template<typename T, typename A>
+void _consume( const tinymage<T,A>& img )
+{
+    if ( img.size() )
+        g_sink = g_sink + static_cast<float>( img.c_at( img.width()/2, img.height()/2 ) );
+}
+
+template<typename T, typename A>
+void _consume( const std::pair<tinymage<T,A>,tinymage<T,A>>& sums )
+{
+    _consume( sums.first );
+    _consume( sums.second );
+}
+
+void _consume( const tinymage_types::moments_t& moments )
+{
+    g_sink = g_sink + static_cast<float>( moments.cx + moments.orientation );
+}
+
+// float frames get their edges through 8 bits, as tinydigit does
+tinymage<unsigned char> _sobel( const tinymage<unsigned char>& img, std::size_t nb_threads )
+{
+    return img.get_sobel( nb_threads );
+}
+
+tinymage<unsigned char> _sobel( const tinymage<float>& img, std::size_t nb_threads )
+{
+    return img.convert<unsigned char>().get_sobel( nb_threads );
+}
+
+// digit zone detection : edges max, then thresholded edges projections, without any edges image
+// -> projections are allocated in the frame arena, float frames are converted into a reused 8 bits buffer, as tinydigit does
+using arena_projections_t = std::pair<tinymage<float,tinymage_arena_allocator<float>>,tinymage<float,tinymage_arena_allocator<float>>>;
+
+arena_projections_t _sobel_projections( const tinymage<unsigned char>& img, tinymage<unsigned char>&, tinymage_arena& arena, std::size_t nb_threads )
+{
+    const int edge_max = img.get_sobel_max( nb_threads );
+    return img.get_sobel_line_row_sums( static_cast<unsigned char>( edge_max > 0 ? ( 41 * edge_max + 254 ) / 255 - 1 : 255 ), nb_threads,
+                                        tinymage_arena_allocator<float>( arena ) );
+}
+
+arena_projections_t _sobel_projections( const tinymage<float>& img, tinymage<unsigned char>& frame, tinymage_arena& arena, std::size_t nb_threads )
+{
+    img.view().convert_into( frame );
+    return _sobel_projections( frame, frame, arena, nb_threads );
+}
+
+// digit ranges : summed area table of the mask, then its columns projection, both in the frame arena
+template<typename T>
+tinymage<float,tinymage_arena_allocator<float>> _integral_row_sums( const tinymage<T>& img, tinymage_arena& arena )
+{
+    const tinymage_integral<tinymage_arena_allocator<double>> integral( img, tinymage_arena_allocator<double>( arena ) );
+    return integral.row_sums( 0, 0, integral.width(), integral.height(), tinymage_arena_allocator<float>( arena ) );
+}
+
+// 8 bits projections are computed on the fly from a lazy float conversion
+std::pair<tinymage<float>,tinymage<float>> _line_row_sums( const tinymage<float>& img, std::size_t nb_threads )
+{
+    return img.line_row_sums( nb_threads );
+}
+
+std::pair<tinymage<float>,tinymage<float>> _line_row_sums( const tinymage<unsigned char>& img, std::size_t )
+{
+    return img.lazy().convert<float>().line_row_sums();
+}
+
+// dark noisy background with a bright centered sheet, so that edges and thresholds have some work to do
+template<typename T>
+tinymage<T> make_frame( std::size_t sx, std::size_t sy )
+{
+    tinymage<T> img( sx, sy );
+    std::minstd_rand gen( 42 );
+    tinymage_forXY( img, x, y )
+    {
+        const bool sheet = x > sx/4 && x < 3*sx/4 && y > sy/4 && y < 3*sy/4;
+        img.at( x, y ) = static_cast<T>( ( sheet ? 180 : 40 ) + gen() % 50 );
+    }
+    return img;
+}
+
+// times func until min_time_ms is spent (3 runs at least), after one warm up run
+// -> warm up absorbs the one time costs : thread pool creation, cached tables, first touch of the pages
+template<typename Func>
+void run( const std::string& op, const std::string& type, std::size_t sx, std::size_t sy, const bench_config& cfg, Func func )
+{
+    using clock = std::chrono::steady_clock;
+
+    func();
+
+    constexpr std::size_t max_runs = 100000;
+    std::vector<double> times;
+    times.reserve( max_runs );
+
+    const auto alloc_count = g_alloc_count.load();
+    const auto alloc_bytes = g_alloc_bytes.load();
+
+    double total = 0.;
+    while ( times.size() < 3 || ( total < cfg.min_time_ms * 1e6 && times.size() < max_runs ) )
+    {
+        const auto start = clock::now();
+        func();
+        const auto ns = std::chrono::duration<double, std::nano>( clock::now() - start ).count();
+        times.push_back( ns );
+        total += ns;
+    }
+
+    const auto nb_runs = static_cast<double>( times.size() );
+    const auto allocs = static_cast<double>( g_alloc_count.load() - alloc_count ) / nb_runs;
+    const auto bytes = static_cast<double>( g_alloc_bytes.load() - alloc_bytes ) / nb_runs;
+
+    std::sort( times.begin(), times.end() );
+    const auto pixels = static_cast<double>( sx * sy );
+    const auto median = times[times.size()/2];
+
+    std::cout   << op << ',' << type << ',' << sx << ',' << sy << ',' << cfg.nb_threads << ','
+                << times.size() << ',' << times.front() / pixels << ',' << median / pixels << ','
+                << pixels * 1e3 / median << ',' << allocs << ',' << bytes << std::endl;
+}
+
+template<typename T>
+void bench_type( const std::string& type, const bench_config& cfg )
+{
+    const std::vector<std::pair<std::size_t,std::size_t>> sizes{ { 28, 28 }, { 128, 128 }, { 640, 480 }, { 1920, 1080 }, { 3840, 2160 } };
+
+    for ( const auto& size : sizes )
+    {
+        const auto sx = size.first;
+        const auto sy = size.second;
+        const auto nb_threads = cfg.nb_threads;
+
+        const auto img = make_frame<T>( sx, sy );
+        auto work = img;
+        tinymage<unsigned char> frame;
+        tinymage_arena arena;
+
+        const auto w = sx - 1;
+        const auto h = sy - 1;
+        const auto mx = sx / 20;
+        const auto my = sy / 20;
+        const tinymage_types::quad_coord_t incoord{ { 0U, 0U }, { w, 0U }, { w, h }, { 0U, h } };
+        const tinymage_types::quad_coord_t outcoord{ { mx, 0U }, { w, my }, { w - mx, h }, { 0U, h - my } };
+
+        run( "get_sobel", type, sx, sy, cfg, [&]() { _consume( _sobel( img, nb_threads ) ); } );
+        run( "get_rotate", type, sx, sy, cfg, [&]() { _consume( img.get_rotate( 30.f, 0, nb_threads ) ); } );
+        run( "get_warp", type, sx, sy, cfg, [&]() { _consume( img.get_warp( incoord, outcoord, nb_threads ) ); } );
+        run( "get_resize", type, sx, sy, cfg, [&]() { _consume( img.get_resize( sx/2, sy/2, nb_threads ) ); } );
+        run( "auto_threshold", type, sx, sy, cfg, [&]() { _consume( img.get_auto_threshold( tinymage_types::threshold_method::isodata, nb_threads ) ); } );
+        run( "line_row_sums", type, sx, sy, cfg, [&]() { _consume( _line_row_sums( img, nb_threads ) ); } );
+        run( "sobel_projections", type, sx, sy, cfg, [&]() { arena.reset(); _consume( _sobel_projections( img, frame, arena, nb_threads ) ); } );
+        run( "integral_row_sums", type, sx, sy, cfg, [&]() { arena.reset(); _consume( _integral_row_sums( img, arena ) ); } );
+        run( "get_crop", type, sx, sy, cfg, [&]() { _consume( img.get_crop( sx/4, sy/4, 3*sx/4, 3*sy/4 ) ); } );
+        run( "convert_uchar", type, sx, sy, cfg, [&]() { _consume( img.template convert<unsigned char>() ); } );
+        run( "get_moments", type, sx, sy, cfg, [&]() { _consume( img.get_moments( nb_threads ) ); } );
+        run( "get_gaussian", type, sx, sy, cfg, [&]() { _consume( img.template get_gaussian<2>( 1.f, tinymage_types::border_policy::clamp, nb_threads ) ); } );
+        run( "get_box_blur", type, sx, sy, cfg, [&]() { _consume( img.get_box_blur( 2, 2, tinymage_types::border_policy::clamp, nb_threads ) ); } );
+        // normalizing an already normalized image costs the same reduction and mapping passes
+        run( "normalize", type, sx, sy, cfg, [&]() { work.normalize( 0, 255, nb_threads ); _consume( work ); } );
+    }
+}
+
+} // namespace
+
+int main( int argc, char **argv )
+{
+    bench_config cfg;
+    if ( argc > 1 )
+        cfg.min_time_ms = std::atof( argv[1] );
+    if ( argc > 2 )
+        cfg.nb_threads = static_cast<std::size_t>( std::atoi( argv[2] ) );
+
+    std::cout << "op,type,width,height,threads,iterations,min_ns_per_pixel,median_ns_per_pixel,mpixels_per_s,allocs_per_call,bytes_per_call" << std::endl;
+
+    bench_type<float>( "float", cfg );
+    bench_type<unsigned char>( "uchar", cfg );
+
+    return 0;
+}
@@ -25,9 +25,46 @@ THE SOFTWARE.
 #include "tiny_brain/tinymage.h"
 
 #include <iostream>
+#include <random>
+
+// the SIMD sobel must be bit exact with the scalar reference, on whole images and on strided crop views
+bool check_sobel()
+{
+    std::mt19937 rng( 42 );
+    std::uniform_int_distribution<int> dist( 0, 255 );
+
+    for ( std::size_t sx : { 3, 15, 16, 17, 33, 64, 100, 641 } )
+    {
+        tinymage<unsigned char> img( sx, 23 );
+        tinymage_forXY( img, x, y )
+            img.at( x, y ) = static_cast<unsigned char>( dist( rng ) );
+
+        const auto sub = img.get_crop_view( 1, 2, sx, 21 );
+        for ( const auto& view : { img.view(), sub } )
+        {
+            const auto sobel = view.get_sobel();
+            const auto sobel_ref = view.get_sobel_ref();
+            tinymage_forXY( sobel, x, y )
+            {
+                if ( sobel.c_at( x, y ) != sobel_ref.c_at( x, y ) )
+                {
+                    std::cout << "check_sobel - mismatch on a " << view.width() << "x" << view.height() << " view at "
+                              << x << "," << y << " : " << int( sobel.c_at( x, y ) ) << " vs " << int( sobel_ref.c_at( x, y ) ) << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    std::cout << "check_sobel - SIMD and reference sobel match" << std::endl;
+    return true;
+}
 
 int main( int argc, char **argv )
 {
+    if ( !check_sobel() )
+        return 1;
+
     tinymage<float> img;
     img.load( "../data/ocr/images/123456.png" );
     img.display();
@@ -81,11 +81,11 @@ public:
         	{
         	case model::kaggle:
             	m_net_manager.load( std::string(TINY_MODEL_PATH) + "kaggle-mnist-model" );
-            	m_model_infos = { 32, -1.f, 1.f };
+            	m_model_infos = { g_kaggle_input_size, -1.f, 1.f };
             	break;
         	case model::caffe:
             	m_net_manager.load( std::string(TINY_MODEL_PATH) + "caffe-mnist-model" );
-            	m_model_infos = { 28, 0.f, 1.f };
+            	m_model_infos = { g_caffe_input_size, 0.f, 1.f };
             	break;
         	}
         }
@@ -100,13 +100,24 @@ public:
 
     void process( const tinymage<float>& img )
     {
-        m_cropped_numbers = _get_cropped_numbers( img );
-        m_cropped_numbers.normalize( 0.f, 255.f );
-        m_cropped_numbers.auto_threshold();
+        // temporaries of the previous frame are released all at once
+        m_arena.reset();
+
+        // inversion, normalization and thresholding are fused in a single evaluation pass
+        // -> passes are threaded according to the cropped numbers size
+        constexpr auto nb_threads = tinymage_types::auto_threads;
+        // -> the crop is 8 bits, so reductions read its raw histogram and the evaluation is a table lookup
+        // -> evaluated into the member 0/1 mask, which keeps its buffer from frame to frame
+        ( 1.f - _get_cropped_numbers( img ).lazy().template convert<float>() ).normalize( 0.f, 255.f, nb_threads )
+            .auto_threshold( tinymage_types::threshold_method::isodata, nb_threads )
+            .template convert<unsigned char>().eval_into( m_cropped_numbers, nb_threads );
         //m_cropped_numbers.display();
 
-        std::vector<t_digit_interval> number_intervals;
-        _compute_ranges( m_cropped_numbers, number_intervals );
+        t_digit_intervals number_intervals( _alloc() );
+        // all number projections are answered by a single summed area table
+        const t_integral integral( m_cropped_numbers, _alloc() );
+
+        _compute_ranges( integral, number_intervals );
 
         std::cout << "tinydigit::process - started inferring numbers on detected intervals" << std::endl;
 
@@ -119,21 +130,16 @@ public:
             }
 
             std::cout << "tinydigit::process - cropping at " << ni.first << " " << ni.second << std::endl;
-            auto cropped_number = m_cropped_numbers.get_columns( ni.first, ni.second );
-
-            //cropped_number.display();
+            auto cropped_view = m_cropped_numbers.get_columns_view( ni.first, ni.second );
 
-            std::cout << "tinydigit::process - centering number" << std::endl;
-            _center_number( cropped_number );
+            //cropped_view.display();
 
-            // convert imagefile to vec_t
-            cropped_number.canvas_resize( m_model_infos.input_size, m_model_infos.input_size );
-            cropped_number.normalize( m_model_infos.input_min_range, m_model_infos.input_max_range );
+            std::cout << "tinydigit::process - centering number and computing augmented output" << std::endl;
 
-            std::cout << "tinydigit::process - computing augmented output" << std::endl;
-
-			// recognize using data augmentation
-            const auto best_digit = _compute_augmented_output( cropped_number );
+			// recognize using data augmentation, on a patch of the model input size and range
+            const auto best_digit = ( m_model_infos.input_size == g_kaggle_input_size ) ?
+                _compute_augmented_output( _center_number<g_kaggle_input_size>( cropped_view, integral, ni ) ) :
+                _compute_augmented_output( _center_number<g_caffe_input_size>( cropped_view, integral, ni ) );
 
             std::cout << "tinydigit::process - max comp idx: " << best_digit.index << " max comp val: " << best_digit.score << std::endl;
 
@@ -145,7 +151,7 @@ public:
         std::cout << "tinydigit::process - ended inferring numbers on detected intervals" << std::endl;
     }
 
-    const tinymage<float>& cropped_numbers()
+    const tinymage<unsigned char>& cropped_numbers()
     {
         return m_cropped_numbers;
     }
@@ -162,6 +168,12 @@ public:
 
 private:
 
+    // network input patches dimensions
+    static constexpr std::size_t g_caffe_input_size = 28;
+    static constexpr std::size_t g_kaggle_input_size = 32;
+    // MNIST digits are centered in 28x28 patches, whatever the model input size
+    static constexpr std::size_t g_mnist_patch_size = 28;
+
     struct best_digit_infos
     {
         float score = 0.f;
@@ -178,34 +190,39 @@ private:
         return { *max_score_elem, max_index };
     }
 
-    best_digit_infos _compute_augmented_output( tinymage<float>& img )
+    // img is already in the model input range, it is augmented in place of a single inline patch
+    template<std::size_t N>
+    best_digit_infos _compute_augmented_output( const tinymage_fixed<float,N,N>& img )
     {
         // ONLY ROTATION AND SHIFTING AUGMENTATION ARE IMPLEMENTED YET
         constexpr auto rotations = tinyutils::make_symetric_sequence<R>();
         constexpr auto x_shifts = tinyutils::make_symetric_sequence<SX>();
         constexpr auto y_shifts = tinyutils::make_symetric_sequence<SY>();
 
+        // one prediction per augmentation, the network allocating each of them
         std::vector<tiny_dnn::vec_t> vec_res;
+        vec_res.reserve( rotations.size() * x_shifts.size() * y_shifts.size() );
+
+        // the rotation and both shifts are composed into a single cached remap table
+        // -> the network input buffer is allocated once for all augmentations
+        tinymage_fixed<float,N,N> augmented;
+        tiny_dnn::vec_t net_input( augmented.size() );
 
         for ( const auto& rot : rotations )
         {
-            // rotate and predict
-            auto rotated = img.get_rotate( rot, m_model_infos.input_min_range );
-            //rotated.display();
+            const auto rotation = tinymage_types::transform_t::rotation( rot, img.width(), img.height() );
 
             for ( const auto& xshift : x_shifts )
             {
-                auto xshifted = rotated.get_shift( xshift, 0 );
-                //xshifted.display();
-
                 for ( const auto& yshift : y_shifts )
                 {
-                    auto yshifted = xshifted.get_shift( 0, yshift );
-                    //yshifted.display();
+                    // rotate, shift and predict
+                    m_remap_cache.get( rotation, img.width(), img.height(), xshift, yshift )
+                        .apply( img.view(), augmented, m_model_infos.input_min_range );
+                    //augmented.display();
 
-            		vec_res.emplace_back(
-                		m_net_manager.predict( tiny_dnn::vec_t( yshifted.data(), yshifted.data() + yshifted.size() ) )
-            		);
+                    std::copy( augmented.data(), augmented.data() + augmented.size(), net_input.begin() );
+            		vec_res.emplace_back( m_net_manager.predict( net_input ) );
 
     				//const auto best_digit = _get_best_digit( vec_res.back() );
             		//std::cout << "network_manager::compute_augmented_output - rot" <<
@@ -228,38 +245,40 @@ private:
         return best_digit;
     }
 
-    tinymage<float> _get_cropped_numbers( const tinymage<float>& input )
+    // returns a view on the numbers zone of the member 8 bits copy of the input image, valid until the next frame
+    // -> the input is only converted once, the whole locate and crop stage then runs on 8 bits pixels
+    tinymage_view<unsigned char> _get_cropped_numbers( const tinymage<float>& input )
     {
-        auto work = input.convert<unsigned char>();
+        constexpr auto nb_threads = tinymage_types::auto_threads;
+        input.view().convert_into( m_frame );
+        const auto& work = m_frame;
 
-        // returns [0...255] clamped image
-        auto work_edge = work.get_sobel();
+        // edges are [0...255] clamped and zero on the image borders, so their normalization only depends on their max
+        // -> a first streaming pass only computes that max, no edges image is ever stored
+        const int edge_max = work.get_sobel_max( nb_threads );
 
-        work_edge.normalize( 0, 255 ); // utile, rapport avec thresh à 40?
-        //work_edge.display();
-
-        std::cout << "tinydigit::get_cropped_numbers - image mean value is " << static_cast<int>( work_edge.mean() ) << std::endl;
+        std::cout << "tinydigit::get_cropped_numbers - edges max value is " << edge_max << std::endl;
         // TODO " , noise variance is " << work_edge.variance_noise() << std::endl;
 
         // TODO
         // if ( work_edge.variance_noise() > 10.f )
         // {
-        // 	work_edge.erode( 3 );
+        // 	work_edge.erode( 3, 3 );
         // 	std::cout << "tinydigit::get_cropped_numbers - post erosion mean value is " << work_edge.mean() << " , post erosion noise variance is " << work_edge.variance_noise() << std::endl;
         // }
 
-        work_edge.threshold( 40 );
-        //work_edge.display();
-
-        auto line_rows = work_edge.convert<float>().line_row_sums();
+        // normalized edges above 40 ( utile, rapport avec thresh à 40? ) are the raw ones of at least ceil( 41 * max / 255 )
+        // -> the second pass computes, thresholds and counts the edges line by line
+        const auto edge_thresh = static_cast<unsigned char>( edge_max > 0 ? ( 41 * edge_max + 254 ) / 255 - 1 : 255 );
+        auto line_rows = work.get_sobel_line_row_sums( edge_thresh, nb_threads, _alloc() );
 
         // Compute line sums image
-        tinymage<float>& line_sums =  line_rows.first;
+        auto& line_sums =  line_rows.first;
         line_sums.threshold( 5.f );
         //line_sums.display();
 
         // Compute row sums image
-        tinymage<float>& row_sums = line_rows.second;
+        auto& row_sums = line_rows.second;
         row_sums.threshold( 5.f );
         //row_sums.display();
 
@@ -311,14 +330,17 @@ private:
 
         std::cout << "tinydigit::get_cropped_numbers - " << margin << " / " << startX << " " << startY << " " << stopX << " " << stopY << std::endl;
 
-        return 1.f - input.get_crop( startX, startY, stopX, stopY );
+        return work.get_crop_view( startX, startY, stopX, stopY );
     }
 
     using t_digit_interval = std::pair<size_t,size_t>;
-    void _compute_ranges( const tinymage<float>& input, std::vector<t_digit_interval>& number_intervals )
+    using t_digit_intervals = std::vector<t_digit_interval,tinymage_arena_allocator<t_digit_interval>>;
+    using t_integral = tinymage_integral<tinymage_arena_allocator<double>>;
+
+    void _compute_ranges( const t_integral& integral, t_digit_intervals& number_intervals )
     {
         // Compute row sums image
-        tinymage<float> row_sums( input.row_sums() );
+        auto row_sums = integral.row_sums( 0, 0, integral.width(), integral.height(), _alloc() );
 
         row_sums.threshold( 1.f );
 
@@ -351,10 +373,14 @@ private:
         }
     }
 
-    void _center_number( tinymage<float>& input )
+    // input is the interval columns view of the image integral was built from
+    // -> returns the N x N network input, in the model range
+    template<std::size_t N>
+    tinymage_fixed<float,N,N> _center_number(
+        const tinymage_view<unsigned char>& input, const t_integral& integral, const t_digit_interval& interval )
     {
         // Compute row sums image
-        tinymage<float> row_sums( input.row_sums() );
+        auto row_sums = integral.row_sums( interval.first, 0, interval.second, integral.height(), _alloc() );
         row_sums.threshold( g_min_digit_thickness );
         //row_sums.display();
 
@@ -379,7 +405,7 @@ private:
         }
 
         // Compute line sums image
-        tinymage<float> line_sums( input.line_sums() );
+        auto line_sums = integral.line_sums( interval.first, 0, interval.second, integral.height(), _alloc() );
         line_sums.threshold( g_min_digit_thickness );
         //line_sums.display();
 
@@ -408,42 +434,74 @@ private:
         if ( ( stopX <= startX ) || ( stopY <= startY ) )
         {
             std::cout << "center_number - invalid centering request..." << std::endl;
-            return;
+            auto resized = input.lazy().template convert<float>().eval( 1, _alloc() ).view()
+                .template get_resize<g_mnist_patch_size,g_mnist_patch_size>().template get_canvas_resize<N,N>();
+            resized.normalize( m_model_infos.input_min_range, m_model_infos.input_max_range );
+            return resized;
         }
 
         // try to prepare image like MNIST does:
         // http://yann.lecun.com/exdb/mnist/
+        // -> the digit box is fitted in a square, resized to 20x20 and normalized to [0...255],
+        //    then centered on its mass center in a 28x28 patch, itself centered in the N x N model input
+        // -> the square canvas is never materialized, the resampler skipping its zero padding, and the final patch
+        //    is written in a single pass, range normalization included
 
         //std::size_t max_dim = std::max( input.width(), input.height() );
         std::size_t max_dim = std::max( stopX - startX, stopY - startY );
 
-        input.crop( startX, startY, stopX, stopY );
-        input.canvas_resize( max_dim, max_dim, 0.5f, 0.5f );
-        input.resize( 20, 20 );
-        input.normalize( 0, 255 );
+        // stb filters, with weights cached per digit size
+        // -> first float pixels, the 0/1 mask being resampled straight into the float patch
+        // -> the digit crop is centered in its square box, as canvas_resize does
+        const auto digit = input.get_crop_view( startX, startY, stopX, stopY );
+        tinymage_fixed<float,20,20> output;
+        m_resampler_cache.get( max_dim, max_dim, 20, 20 ).apply( digit, ( max_dim - digit.width() ) / 2, ( max_dim - digit.height() ) / 2, output );
+        output.normalize( 0, 255 );
 
         // compute center of mass
+        // NOTE : each term is truncated as accumulated, recognitions depend on it as the exact
+        //        tinymage_view::get_moments centroid shifts some digits by a pixel
         std::size_t massX = 0;
         std::size_t massY = 0;
         std::size_t num = 0;
-        tinymage_forXY( input, x, y )
+        tinymage_forXY( output, x, y )
         {
-            massX += input.at( x, y ) * x;
-            massY += input.at( x, y ) * y;
-            num += input.at( x, y );
+            massX += output.at( x, y ) * x;
+            massY += output.at( x, y ) * y;
+            num += output.at( x, y );
         }
         massX /= num;
         massY /= num;
 
         std::cout << "center_number - Mass center X=" << massX << " Y=" << massY << std::endl;
 
-        input.canvas_resize(    28, 28,
-                                1.f - static_cast<float>( massX ) / 20.f,
-                                1.f - static_cast<float>( massY ) / 20.f );
+        // 20x20 placement in the 28x28 MNIST patch, as canvas_resize does, then of that patch in the model input
+        const auto xc = static_cast<std::size_t>( ( 1.f - static_cast<float>( massX ) / 20.f ) * ( g_mnist_patch_size - 20 ) )
+                        + ( N - g_mnist_patch_size ) / 2;
+        const auto yc = static_cast<std::size_t>( ( 1.f - static_cast<float>( massY ) / 20.f ) * ( g_mnist_patch_size - 20 ) )
+                        + ( N - g_mnist_patch_size ) / 2;
+
+        // the patch spans [0...255] over a zero background, so its normalization to [0...1] then to the model range
+        // is a fixed mapping, the background becoming the range min
+        const double out_dyn = m_model_infos.input_max_range - m_model_infos.input_min_range;
+        auto to_range = [&]( float val )
+            {
+                return static_cast<float>( m_model_infos.input_min_range + out_dyn * static_cast<float>( val / 255. ) );
+            };
+
+        tinymage_fixed<float,N,N> centered( to_range( 0.f ) );
+        tinymage_forXY( output, x, y )
+            centered.at( x + xc, y + yc ) = to_range( output.at( x, y ) );
 
-        input.normalize( 0.f, 1.f );
+        //centered.view().display();
 
-        //input.display();
+        return centered;
+    }
+
+    // per frame temporaries are allocated in the arena
+    tinymage_arena_allocator<float> _alloc()
+    {
+        return tinymage_arena_allocator<float>( m_arena );
     }
 
 private:
@@ -453,6 +511,10 @@ private:
     static constexpr auto g_min_digit_thickness = 1.f; // TODO-AM compute smartly??
 
     std::vector<reco> m_recognitions;
-    tinymage<float> m_cropped_numbers;
+    tinymage<unsigned char> m_frame;
+    tinymage<unsigned char> m_cropped_numbers;
+    tinymage_remap_cache m_remap_cache;
+    tinymage_resampler_cache m_resampler_cache;
+    tinymage_arena m_arena;
     tiny_dnn::network<tiny_dnn::sequential> m_net_manager;
 };
@@ -26,8 +26,18 @@ THE SOFTWARE.
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -53,6 +63,26 @@ THE SOFTWARE.
 
 #include "third_party/linalg.h"
 
+#include "tiny_brain/tinyutils.h"
+
+// SIMD code paths follow the tiny-dnn build options set in the top-level CMakeLists.txt
+#if defined(CNN_USE_AVX2)
+    #define TINYMAGE_USE_AVX2
+#endif
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX) || defined(CNN_USE_AVX2)
+    #define TINYMAGE_USE_SSE
+    #include <immintrin.h>
+#endif
+
+// raw and PGM files are memory mapped where available, read in a single buffer otherwise
+#if ( defined(__unix__) || defined(__APPLE__) ) && !defined(__EMSCRIPTEN__)
+    #define TINYMAGE_USE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 #define tinymage_for1(bound,i) for (std::size_t i = 0UL; i<bound; ++i)
 #define tinymage_forX(img,x) tinymage_for1( img.width(), x )
 #define tinymage_forY(img,y) tinymage_for1( img.height(), y )
@@ -61,219 +91,470 @@ THE SOFTWARE.
 namespace tinymage_types {
     using coord_t = std::pair<size_t,size_t>;
     using quad_coord_t = std::tuple<coord_t,coord_t,coord_t,coord_t>;
+
+    // row alignment in bytes requested by an allocator through an 'alignment' member, 1 if none
+    template<typename A, typename = void>
+    struct row_alignment : std::integral_constant<std::size_t, 1> {};
+    template<typename A>
+    struct row_alignment<A, decltype( void( A::alignment ) )> : std::integral_constant<std::size_t, A::alignment> {};
+
+    // nb_threads value letting operations choose their threads count from the image size:
+    // small images (e.g. digit patches) stay serial, full frames are split across the hardware threads
+    constexpr std::size_t auto_threads = 0;
+
+    // interleaved 8 bits layouts accepted by tinymage::ingest
+    enum class pixel_format
+    {
+        gray,
+        rgb,
+        bgr,
+        rgba,
+        bgra
+    };
+
+    // low-pass filter applied before each pyramid decimation
+    enum class pyramid_filter
+    {
+        box,        // 2x2 mean
+        gaussian    // separable [1 2 1] kernel centered on the even pixels
+    };
+
+    // horizontal run of set pixels of a line, x1 excluded
+    struct run_t
+    {
+        std::size_t x0, x1;
+    };
+
+    // connected component bounding box { x0, y0, x1, y1 } (inclusive) and pixels count
+    struct blob_t
+    {
+        std::size_t x0, y0, x1, y1, area;
+    };
+
+    // raw moments m_pq = sum of x^p.y^q.I(x,y) and central moments mu_pq up to order 2, weighted centroid,
+    // bounding box { x0, y0, x1, y1 } (inclusive) of the non zero pixels and major axis orientation in radians
+    // -> without any mass, centroid and orientation are NaN, and without any non zero pixel the box is empty ( x1 < x0 )
+    struct moments_t
+    {
+        double m00, m10, m01, m20, m11, m02;
+        double mu20, mu11, mu02;
+        double cx, cy;
+        double orientation;
+        std::size_t x0, y0, x1, y1;
+    };
+
+    // sums of I, x.I and x^2.I over a line, and its first and last non zero pixels ( first == width if none )
+    struct line_moments_t
+    {
+        double s, sx, sxx;
+        std::size_t first, last;
+    };
+
+    // pixels read past the image boundaries by filters
+    enum class border_policy
+    {
+        clamp,      // nearest boundary pixel
+        mirror,     // reflection about the boundary pixel : ... 2 1 | 0 1 2 ...
+        zero        // zero padding
+    };
+
+    // normalized gaussian kernel of radius R, for tinymage_view::get_convolve
+    template<std::size_t R>
+    std::array<float,2*R+1> gaussian_kernel( float sigma )
+    {
+        std::array<float,2*R+1> kernel;
+        auto sum = 0.f;
+        for ( std::size_t i = 0; i < kernel.size(); ++i )
+        {
+            const auto d = static_cast<float>( i ) - static_cast<float>( R );
+            kernel[i] = std::exp( -d*d / ( 2.f*sigma*sigma ) );
+            sum += kernel[i];
+        }
+        for ( auto& k : kernel )
+            k /= sum;
+        return kernel;
+    }
+
+    // automatic threshold selection algorithms, both computed on a 256 bins histogram
+    enum class threshold_method
+    {
+        isodata,
+        otsu
+    };
+
+    // pixel operation leaving values untouched, used as root of lazy expressions
+    struct identity_t
+    {
+        template<typename V>
+        V operator()( const V& val ) const { return val; }
+    };
+
+    // projective mapping from output pixel coordinates to source image coordinates, relative to the ( ox, oy ) origin:
+    // xs = ( a*(x-ox) + b*(y-oy) + c ) / ( g*(x-ox) + h*(y-oy) + 1 )
+    // ys = ( d*(x-ox) + e*(y-oy) + f ) / ( g*(x-ox) + h*(y-oy) + 1 )
+    // affine mappings have g = h = 0 and need no division at all
+    // -> every resampler evaluates these terms in this order, so positions falling exactly on the image border
+    //    round as the original per pixel rotation and homography did
+    struct transform_t
+    {
+        float a = 1.f, b = 0.f, c = 0.f;
+        float d = 0.f, e = 1.f, f = 0.f;
+        float g = 0.f, h = 0.f;
+        float ox = 0.f, oy = 0.f;
+
+        bool is_affine() const { return g == 0.f && h == 0.f; }
+
+        // rotation of angle degrees around the center of a sx*sy image
+        static transform_t rotation( float angle, std::size_t sx, std::size_t sy )
+        {
+            // define the center of the image, which is the center of rotation.
+            auto horizontal_center = static_cast<float>( sx / 2 );
+            auto vertical_center = static_cast<float>( sy / 2 );
+
+            auto _rad = angle * m_pi / 180.f;
+            auto _cos = std::cos( _rad );
+            auto _sin = std::sin( _rad );
+
+            transform_t tr;
+            tr.a = _cos;
+            tr.b = -_sin;
+            tr.c = horizontal_center;
+            tr.d = _sin;
+            tr.e = _cos;
+            tr.f = vertical_center;
+            tr.ox = horizontal_center;
+            tr.oy = vertical_center;
+            return tr;
+        }
+
+        // perspective mapping of the in_coords quad onto the out_coords quad
+        static transform_t homography( const quad_coord_t& in_coords, const quad_coord_t& out_coords )
+        {
+            // NOTE1:
+            // The homography equations computation is based on :
+            // http://www.corrmap.com/features/homography_transformation.php
+            // NOTE2:
+            // 8x8 Matrix inversion is performed using 4x4 block matrix inversion,
+            // as linalg does not support sizes > 4
+            // https://en.wikipedia.org/wiki/Block_matrix#Block_matrix_inversion
+
+            using namespace linalg::aliases;
+
+            float4 x( std::get<0>(in_coords).first, std::get<1>(in_coords).first, std::get<2>(in_coords).first, std::get<3>(in_coords).first );
+            float4 y( std::get<0>(in_coords).second, std::get<1>(in_coords).second, std::get<2>(in_coords).second, std::get<3>(in_coords).second );
+            float4 X( std::get<0>(out_coords).first, std::get<1>(out_coords).first, std::get<2>(out_coords).first, std::get<3>(out_coords).first );
+            float4 Y( std::get<0>(out_coords).second, std::get<1>(out_coords).second, std::get<2>(out_coords).second, std::get<3>(out_coords).second );
+
+            // initialize transformation matrix (!!column major order!!)
+            float4x4 hA, hB, hC, hD;
+            hA = { x, y, { 1.f, 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f, 0.f } };
+            hB = { { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, -x*X, -y*X };
+            hC = { { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, x };
+            hD = { y, { 1.f, 1.f, 1.f, 1.f }, -x*Y, -y*Y };
+
+            // invert transformation matrix
+            float4x4 ihA, ihB, ihC, ihD;
+
+            // compute block inverse homography matrix
+            auto invhD = inverse( hD );
+            ihA = inverse( hA - mul( hB, mul( invhD, hC ) ) );
+            ihB = mul( -ihA, mul( hB, invhD ) );
+            ihC = mul( -invhD, mul( hC, ihA ) );
+            ihD = invhD - mul( ihC, mul( hB, invhD ) );
+
+            // compute transformation parameters vector
+            float4 abcd = mul( ihA, X ) + mul( ihB, Y );
+            auto a = abcd[0], b = abcd[1], c = abcd[2], d = abcd[3];
+            float4 efgh = mul( ihC, X ) + mul( ihD, Y );
+            auto e = efgh[0], f = efgh[1], g = efgh[2], h = efgh[3];
+
+            // invert 3x3 homography matrix, as output pixels are mapped back to the source
+            float3x3 homog = inverse( float3x3{{a,d,g},{b,e,h},{c,f,1.f}} );
+
+            transform_t tr;
+            tr.a = homog[0][0], tr.d = homog[0][1], tr.g = homog[0][2], tr.b = homog[1][0];
+            tr.e = homog[1][1], tr.h = homog[1][2], tr.c = homog[2][0], tr.f = homog[2][1];
+            return tr;
+        }
+
+    private:
+
+        constexpr static float m_pi{ 3.14159265358979323846f };
+
+        // gcc does compile this, but acos being constexpr compatible is not in the standard!
+        // https://stackoverflow.com/questions/32814678/constexpr-compile-error-with-clang-not-g
+        // constexpr static float m_pi{ std::acos( -1.f ) };
+    };
 }
 
-// lightweight header only image class
+template<typename T=float, typename Alloc=std::allocator<T>>
+class tinymage;
+
+template<typename T, std::size_t W, std::size_t H>
+class tinymage_fixed;
+
+class tinymage_binary;
+class tinymage_rle;
+
+template<typename T, typename F>
+class tinymage_expr;
+
+// lightweight non-owning strided image view
+// -> cropping a view is O(1), pixels are only copied when explicitly materialized
+// -> the viewed buffer must outlive the view
 template<typename T=float>
-class tinymage final : private std::vector<T>
+class tinymage_view final
 {
-    // any other type of tinymage is a friend.
-    template <typename U>
+    // tinymage, lazy expressions and binary images are allowed to reuse the view private helpers
+    template <typename U, typename B>
     friend class tinymage;
+    template <typename U, typename G>
+    friend class tinymage_expr;
+    friend class tinymage_binary;
+    friend class tinymage_rle;
 
-    template<typename U,typename V>
-    using tinymage_if = std::enable_if_t<std::is_same<V, U>::value, tinymage<U>>;
+    template<typename U,typename V,typename A=std::allocator<U>>
+    using tinymage_if = std::enable_if_t<std::is_same<V, U>::value, tinymage<U,A>>;
     template<typename U,typename V>
     using tinymage_if_pair = std::enable_if_t<std::is_same<V, U>::value, std::pair<tinymage<U>,tinymage<U>>>;
 
-    template<typename U> using tinymage_if_uchar = tinymage_if<U,unsigned char>;
-    template<typename U> using tinymage_if_float = tinymage_if<U,float>;
+    template<typename U,typename A=std::allocator<U>> using tinymage_if_uchar = tinymage_if<U,unsigned char,A>;
+    template<typename U,typename A=std::allocator<U>> using tinymage_if_float = tinymage_if<U,float,A>;
 
     template<typename U> using tinymage_if_pair_float = tinymage_if_pair<U,float>;
 
-    using std::vector<T>::at;
-    using std::vector<T>::assign;
-    using std::vector<T>::size;
-
-    using std::vector<T>::begin;
-    using std::vector<T>::end;
-
 public:
 
-    using std::vector<T>::data;
-
-    tinymage() : m_width{0}, m_height{0} {}
-    tinymage( std::size_t sx, std::size_t sy, T val = 0 ) : std::vector<T>( sx*sy, val ), m_width{sx}, m_height{sy} {}
-    tinymage( uint8_t* buf, std::size_t sx, std::size_t sy, std::size_t bpp ) : m_width{sx}, m_height{sy}
+    tinymage_view() : m_data{nullptr}, m_width{0}, m_height{0}, m_stride{0} {}
+    tinymage_view( const T* data, std::size_t sx, std::size_t sy )
+        : m_data{data}, m_width{sx}, m_height{sy}, m_stride{sx} {}
+    tinymage_view( const T* data, std::size_t sx, std::size_t sy, std::size_t stride )
+        : m_data{data}, m_width{sx}, m_height{sy}, m_stride{stride}
     {
-        assert( bpp == sizeof(T) );
-        assign( buf, buf + sx*sy );
+        assert( stride >= sx );
     }
 
     std::size_t size() const { return m_width * m_height; }
 
-    bool load( const std::string& img_path )
-    {
-        int width, height, bpp;
-        auto gray_image = stbi_load( img_path.c_str(), &width, &height, &bpp, 1); // force grayscale at image load
-        if ( gray_image == nullptr )
-            return false;
-        assert( bpp == sizeof(T) );
-        m_width = static_cast<std::size_t>( width );
-        m_height = static_cast<std::size_t>( height );
-        assign( gray_image, gray_image + m_width*m_height );
-        stbi_image_free( gray_image );
-        return true;
-    }
-
-    bool save_png( const std::string& img_path )
-    {
-        return stbi_write_png( img_path.c_str(), static_cast<int>( m_width ), static_cast<int>( m_height ), 1,
-			data(), static_cast<int>( m_width * sizeof(T) ) ) != 0;
-    }
-
     std::size_t width() const { return m_width; }
     std::size_t height() const { return m_height; }
 
-    T& operator[]( std::size_t i )
-    {
-        return at( i );
-    }
+    // distance in elements between two consecutive lines
+    std::size_t stride() const { return m_stride; }
 
-    T& at( std::size_t x, std::size_t y )
+    bool is_contiguous() const { return m_stride == m_width; }
+
+    const T* data() const { return m_data; }
+
+    const T* line( std::size_t y ) const
     {
-        return at( x + m_width*y );
+        return m_data + m_stride*y;
     }
 
     template<typename T2>
     T2 at( std::size_t x, std::size_t y ) const
     {
-        return static_cast<T2>( at( x + m_width*y ) );
+        return static_cast<T2>( c_at( x, y ) );
     }
 
     const T& c_at( std::size_t x, std::size_t y ) const
     {
-        return at( x + m_width*y );
+        return m_data[ x + m_stride*y ];
     }
 
-    template<typename Func>
-    void apply( Func f )
+    tinymage_view<T> get_crop_view(    std::size_t startx,
+                                        std::size_t starty,
+                                        std::size_t stopx,
+                                        std::size_t stopy ) const
     {
-        std::for_each( begin(), end(), f );
+        assert( stopx >= startx );
+        assert( stopy >= starty );
+
+        assert( stopx <= m_width );
+        assert( stopy <= m_height );
+
+        return tinymage_view<T>( m_data + startx + m_stride*starty, stopx-startx, stopy-starty, m_stride );
     }
 
-    template<typename R>
-    tinymage<R> convert() const
+    tinymage_view<T> get_columns_view(     std::size_t startx,
+                                            std::size_t stopx ) const
     {
-        tinymage<R> output( m_width, m_height, 0 );
-        output.assign( begin(), end() );
-        return output;
+        return get_crop_view( startx, 0, stopx, m_height );
     }
 
-    void normalize( T min, T max )
+    tinymage_view<T> get_lines_view(   std::size_t starty,
+                                        std::size_t stopy ) const
     {
-        _normalize( *this, min, max );
+        return get_crop_view( 0, starty, m_width, stopy );
     }
 
-    tinymage<T> get_normalize( T min, T max ) const
+    // explicit owning copy of the viewed pixels
+    // -> images producing operations take an optional allocator for their output, as materialize does
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> materialize( const A& alloc = A() ) const
     {
-        tinymage<T> output( *this );
-        _normalize( output, min, max );
-        return output;
+        return tinymage<T,A>( *this, alloc );
     }
 
-    T mean() const
+    // same as materialize, into an existing image whose buffer is kept if large enough (see tinymage::reshape)
+    // -> the *_into variants of the images producing operations let long-lived objects reuse their scratch images
+    // NOTE : dst must not be the viewed image
+    template<typename A>
+    void materialize_into( tinymage<T,A>& dst ) const
     {
-        auto sum = 0.;
-
-        std::for_each( begin(), end(), [&]( const T& val )
-            {
-                sum += val;
-            });
-
-        return static_cast<T>( sum / ( m_width * m_height ) );
+        dst.reshape( m_width, m_height );
+        tinymage_forY( (*this), y )
+            std::copy( line( y ), line( y ) + m_width, dst.line( y ) );
     }
 
-    float line_centroid( size_t index )
+    // root of a lazy point-wise expression on the viewed pixels
+    tinymage_expr<T,tinymage_types::identity_t> lazy() const
     {
-        auto _mean = 0.f;
-        auto _total = 0.f;
-        tinymage_forX( (*this),x )
-        {
-            _mean += x * c_at(x,index);
-            _total += c_at(x,index);
-        }
-        return _mean / _total;
+        return tinymage_expr<T,tinymage_types::identity_t>( *this, {} );
     }
 
-    void threshold( T thresh )
+    // float to 8 bits conversion truncates and saturates to [0,255], vectorized when SSE/AVX2 build options are enabled
+    template<typename R, typename A = std::allocator<R>>
+    tinymage<R,A> convert( const A& alloc = A() ) const
     {
-        std::for_each( begin(), end(), [&]( T& val )
-            {
-                val = val > thresh ? m_one : m_zero;
-            });
+        return tinymage<R,A>( *this, alloc );
     }
 
-    tinymage<T> get_crop(   std::size_t startx,
-                            std::size_t starty,
-                            std::size_t stopx,
-                            std::size_t stopy ) const
+    // same as convert, into an existing image whose buffer is kept if large enough
+    template<typename R, typename A>
+    void convert_into( tinymage<R,A>& dst ) const
     {
-        assert( stopx >= startx );
-        assert( stopy >= starty );
+        dst.reshape( m_width, m_height );
+        tinymage_forY( (*this), y )
+            _convert_line( line( y ), dst.line( y ), m_width );
+    }
 
-        assert( stopx-startx <= m_width );
-        assert( stopy-starty <= m_height );
+    tinymage<T> get_normalize( T min, T max, std::size_t nb_threads = 1 ) const
+    {
+        return lazy().normalize( min, max, nb_threads ).eval( nb_threads );
+    }
 
-        tinymage<T> output( stopx-startx, stopy-starty );
+    T mean() const
+    {
+        auto sum = 0.;
 
-        for ( auto yin = starty,yout = std::size_t(0); yin<stopy; yin++, yout++ )
-            for ( auto xin = startx,xout = std::size_t(0); xin<stopx; xin++, xout++ )
-                output.at(xout,yout) = c_at(xin,yin);
+        tinymage_forY( (*this), y )
+            std::for_each( line( y ), line( y ) + m_width, [&]( const T& val )
+                {
+                    sum += val;
+                });
 
-        return output;
+        return static_cast<T>( sum / ( m_width * m_height ) );
     }
 
-    void crop(  std::size_t startx,
-                std::size_t starty,
-                std::size_t stopx,
-                std::size_t stopy )
+    float line_centroid( size_t index ) const
     {
-        *this = get_crop( startx, starty, stopx, stopy );
+        return static_cast<float>( get_crop_view( 0, index, m_width, index + 1 ).get_moments().cx );
     }
 
-    void remove_border( std::size_t px_size )
+    // moments up to order 2, centroid, non zero pixels bounding box and orientation, all from a single pass
+    // -> coordinates are relative to the view, so a crop view gives the moments of that ROI
+    // -> the lines sums may run concurrently on nb_threads threads
+    tinymage_types::moments_t get_moments( std::size_t nb_threads = 1 ) const
     {
-        crop( px_size, px_size, m_width - px_size, m_height - px_size );
+        tinymage_types::moments_t moments{}; // zero init
+        moments.x0 = m_width;
+        moments.y0 = m_height;
+        std::mutex moments_mutex;
+
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                double m00 = 0., m10 = 0., m01 = 0., m20 = 0., m11 = 0., m02 = 0.;
+                std::size_t x0 = m_width, y0 = m_height, x1 = 0, y1 = 0;
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const auto sums = _get_line_moments( line( y ), m_width );
+                    if ( sums.first == m_width ) // no non zero pixel
+                        continue;
+
+                    // the order 1 and 2 y terms only weight the line sums
+                    const double fy = static_cast<double>( y );
+                    m00 += sums.s;
+                    m10 += sums.sx;
+                    m20 += sums.sxx;
+                    m01 += fy * sums.s;
+                    m11 += fy * sums.sx;
+                    m02 += fy * fy * sums.s;
+
+                    x0 = std::min( x0, sums.first );
+                    x1 = std::max( x1, sums.last );
+                    y0 = std::min( y0, y );
+                    y1 = y;
+                }
+
+                std::lock_guard<std::mutex> lock( moments_mutex );
+                moments.m00 += m00;
+                moments.m10 += m10;
+                moments.m01 += m01;
+                moments.m20 += m20;
+                moments.m11 += m11;
+                moments.m02 += m02;
+                moments.x0 = std::min( moments.x0, x0 );
+                moments.y0 = std::min( moments.y0, y0 );
+                moments.x1 = std::max( moments.x1, x1 );
+                moments.y1 = std::max( moments.y1, y1 );
+            });
+
+        if ( moments.m00 == 0. )
+        {
+            moments.cx = moments.cy = moments.orientation = std::numeric_limits<double>::quiet_NaN();
+            return moments;
+        }
+
+        moments.cx = moments.m10 / moments.m00;
+        moments.cy = moments.m01 / moments.m00;
+        moments.mu20 = moments.m20 - moments.cx * moments.m10;
+        moments.mu11 = moments.m11 - moments.cx * moments.m01;
+        moments.mu02 = moments.m02 - moments.cy * moments.m01;
+        moments.orientation = 0.5 * std::atan2( 2. * moments.mu11, moments.mu20 - moments.mu02 );
+
+        return moments;
     }
 
-    void shift( int sx, int sy, T pad_val = 0 )
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_shift( int sx, int sy, T pad_val = 0, const A& alloc = A() ) const
     {
-        *this = get_shift( sx, sy, pad_val );
+        tinymage<T,A> output( alloc );
+        shift_into( output, sx, sy, pad_val );
+        return output;
     }
 
-    tinymage<T> get_shift( int sx, int sy, T pad_val = 0 )
+    // NOTE : unlike the other *_into operations, dst may be the viewed image itself, as pixels only move backwards
+    template<typename A>
+    void shift_into( tinymage<T,A>& output, int sx, int sy, T pad_val = 0 ) const
     {
         assert( std::abs( sx ) <= m_width );
         assert( std::abs( sy ) <= m_height );
 
-        tinymage<T> output( m_width, m_height, pad_val );
-
         std::size_t startx = std::max( sx, 0 );
         std::size_t stopx = std::min( m_width, m_width+sx );
         std::size_t starty = std::max( sy, 0 );
         std::size_t stopy = std::min( m_height, m_height+sy );
 
-        for ( auto yin = starty,yout = std::size_t(0); yin<stopy; yin++, yout++ )
-            for ( auto xin = startx,xout = std::size_t(0); xin<stopx; xin++, xout++ )
-                output.at(xout,yout) = c_at(xin,yin);
-
-        return output;
-    }
-
-    tinymage<T> get_columns(    std::size_t startx,
-                                std::size_t stopx ) const
-    {
-        return get_crop( startx, 0, stopx, m_height );
-    }
+        output.reshape( m_width, m_height );
 
-    tinymage<T> get_lines(  std::size_t starty,
-                            std::size_t stopy ) const
-    {
-        return get_crop( 0, starty, m_width, stopy );
+        tinymage_forY( output, y )
+        {
+            T* out = output.line( y );
+            auto copied = std::size_t(0);
+            if ( y < stopy - starty )
+            {
+                const T* in = line( y + starty ) + startx;
+                copied = stopx - startx;
+                if ( in != out )
+                    std::copy( in, in + copied, out );
+            }
+            std::fill( out + copied, out + m_width, pad_val );
+        }
     }
 
-    tinymage<float> get_dline() const
+    template<typename U = T>
+    tinymage_if_float<U> get_dline() const
     {
         tinymage<T> output( m_width, m_height );
 
@@ -286,7 +567,8 @@ public:
         return output;
     }
 
-    tinymage<float> get_dcolumn() const
+    template<typename U = T>
+    tinymage_if_float<U> get_dcolumn() const
     {
         tinymage<T> output( m_width, m_height );
 
@@ -299,12 +581,18 @@ public:
         return output;
     }
 
-    void canvas_resize( std::size_t nsx, std::size_t nsy, float centering_x = 0.5f, float centering_y = 0.5f )
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_canvas_resize(    std::size_t nsx, std::size_t nsy, float centering_x = 0.5f, float centering_y = 0.5f,
+                                        const A& alloc = A() ) const
     {
-        *this = get_canvas_resize( nsx, nsy, centering_x, centering_y );
+		tinymage<T,A> output( alloc );
+        canvas_resize_into( output, nsx, nsy, centering_x, centering_y );
+        return output;
     }
 
-    tinymage<T> get_canvas_resize( std::size_t nsx, std::size_t nsy, float centering_x = 0.5f, float centering_y = 0.5f  ) const
+    template<typename A>
+    void canvas_resize_into(    tinymage<T,A>& output, std::size_t nsx, std::size_t nsy,
+                                float centering_x = 0.5f, float centering_y = 0.5f ) const
     {
         // Only default dirichlet condition is managed for now
 
@@ -312,447 +600,4369 @@ public:
         assert( centering_x <= 1.f && centering_x >= 0.f );
         assert( centering_y <= 1.f && centering_y >= 0.f );
 
-		tinymage<T> output( nsx, nsy, 0 );
+        output.reshape( nsx, nsy );
 
-        const int32_t   xc{ static_cast<int32_t>( centering_x * ( nsx - m_width ) )},
-                        yc{ static_cast<int32_t>( centering_y * ( nsy - m_height ) )};
+        const std::size_t   xc{ static_cast<std::size_t>( static_cast<int32_t>( centering_x * ( nsx - m_width ) ) ) },
+                            yc{ static_cast<std::size_t>( static_cast<int32_t>( centering_y * ( nsy - m_height ) ) ) };
 
-        tinymage_forXY( (*this), x, y )
+        tinymage_forY( output, y )
         {
-            output.at( x + xc, y + yc ) = c_at( x, y );
+            T* out = output.line( y );
+            if ( y < yc || y >= yc + m_height )
+            {
+                std::fill( out, out + nsx, T(0) );
+                continue;
+            }
+            std::fill( out, out + xc, T(0) );
+            std::copy( line( y - yc ), line( y - yc ) + m_width, out + xc );
+            std::fill( out + xc + m_width, out + nsx, T(0) );
         }
+    }
 
+    // output lines may be resampled concurrently by nb_threads threads, in bands of the same source mapping
+    template<typename U = T, typename A = std::allocator<T>>
+    tinymage_if_uchar<U,A> get_resize( std::size_t nsx, std::size_t nsy, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        tinymage<T,A> output( alloc );
+        resize_into( output, nsx, nsy, nb_threads );
         return output;
     }
 
-    void resize( std::size_t nsx, std::size_t nsy )
+    template<typename U = T, typename A = std::allocator<T>>
+    tinymage_if_float<U,A> get_resize( std::size_t nsx, std::size_t nsy, std::size_t nb_threads = 1, const A& alloc = A() ) const
     {
-        *this = get_resize( nsx, nsy );
+        tinymage<T,A> output( alloc );
+        resize_into( output, nsx, nsy, nb_threads );
+        return output;
     }
 
-    template<typename U = T>
-    tinymage_if_uchar<U> get_resize( std::size_t nsx, std::size_t nsy ) const
+    template<typename A>
+    void resize_into( tinymage<T,A>& output, std::size_t nsx, std::size_t nsy, std::size_t nb_threads = 1 ) const
     {
-        tinymage<T> output( nsx, nsy );
-        stbir_resize_uint8( data(), static_cast<int>( m_width ), static_cast<int>( m_height ), 0,
-			output.data(), static_cast<int>(nsx), static_cast<int>(nsy), 0, 1);
-        return output;
+        static_assert( std::is_same<T,unsigned char>::value || std::is_same<T,float>::value, "unsupported resize type" );
+
+        output.reshape( nsx, nsy );
+        _resize_into( output, std::is_same<T,unsigned char>::value ? STBIR_TYPE_UINT8 : STBIR_TYPE_FLOAT, nb_threads );
     }
 
-    template<typename U = T>
-    tinymage_if_float<U> get_resize( std::size_t nsx, std::size_t nsy ) const
+    // resampling to compile time dimensions, the output pixels being stored inline
+    template<std::size_t W, std::size_t H>
+    tinymage_fixed<T,W,H> get_resize() const
     {
-        tinymage<T> output( nsx, nsy );
-        stbir_resize_float( data(), static_cast<int>( m_width ), static_cast<int>( m_height ), 0,
-			output.data(), static_cast<int>( nsx ), static_cast<int>( nsy ), 0, 1 );
+        static_assert( std::is_same<T,unsigned char>::value || std::is_same<T,float>::value, "unsupported resize type" );
+
+        tinymage_fixed<T,W,H> output;
+        _resize_into( output, std::is_same<T,unsigned char>::value ? STBIR_TYPE_UINT8 : STBIR_TYPE_FLOAT, 1 );
         return output;
     }
 
+    // projections are split by lines (resp. columns), so threaded results are identical to serial ones
     template<typename U = T>
-    tinymage_if_float<U> line_sums() const
+    tinymage_if_float<U> line_sums( std::size_t nb_threads = 1 ) const
     {
         tinymage<U> output( 1, m_height, 0.f );
 
-        std::size_t line_index{0},line_index_out{0},width{m_width};
-
-        std::for_each( begin(), end(), [&]( const T& val )
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
             {
-                output.at(0,line_index_out) += val;
-                if ( ++line_index == width )
-                {
-                    line_index = 0;
-                    line_index_out++;
-                }
+                for ( auto y = start; y < stop; ++y )
+                    output[y] = std::accumulate( line( y ), line( y ) + m_width, output[y] );
             });
 
         return output;
     }
 
     template<typename U = T>
-    tinymage_if_float<U> row_sums() const
+    tinymage_if_float<U> row_sums( std::size_t nb_threads = 1 ) const
     {
         tinymage<U> output( m_width, 1, 0.f );
 
-        std::size_t row_index{0};
-
-        std::for_each( begin(), end(), [&]( const T& val )
+        tinyutils::parallel_for( m_width, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
             {
-                output.at(row_index,0) += val;
-                if ( ++row_index == output.width() )
-                    row_index = 0;
+                tinymage_forY( (*this), y )
+                    for ( auto x = start; x < stop; ++x )
+                        output[x] += c_at( x, y );
             });
 
         return output;
     }
 
+    // the serial path computes both projections in a single pass
     template<typename U = T>
-    tinymage_if_pair_float<U> line_row_sums() const
+    tinymage_if_pair_float<U> line_row_sums( std::size_t nb_threads = 1 ) const
     {
-        auto outputs = std::make_pair<tinymage<float>,tinymage<float>>(
-            tinymage<float>( 1, m_height, 0.f ),
-            tinymage<float>( m_width, 1, 0.f )
-        );
-
-        std::size_t row_index{0};
-        std::size_t line_index{0},line_index_out{0},width{m_width};
+        if ( _nb_tasks( nb_threads ) != 1 )
+            return std::make_pair( line_sums( nb_threads ), row_sums( nb_threads ) );
 
-        std::for_each( begin(), end(), [&]( const T& val )
-            {
-                outputs.first.at(0,line_index_out) += val;
-                if ( ++line_index == width )
-                {
-                    line_index = 0;
-                    line_index_out++;
-                }
+        auto outputs = std::make_pair<tinymage<U>,tinymage<U>>(
+            tinymage<U>( 1, m_height, 0.f ),
+            tinymage<U>( m_width, 1, 0.f )
+        );
 
-                outputs.second.at(row_index,0) += val;
-                if ( ++row_index == outputs.second.width() )
-                    row_index = 0;
-            });
+        tinymage_forXY( (*this), x, y )
+        {
+            const auto& val = c_at( x, y );
+            outputs.first[y] += val;
+            outputs.second[x] += val;
+        }
 
         return outputs;
     }
 
-    //template<typename U = T>
-    //tinymage_if_float<U> row_sums() const
-
+    // histogram of the [min...max] image dynamic, lines may be accumulated concurrently by nb_threads threads
+    // -> 8 bits images are counted by direct indexing, without any min/max pass nor per pixel division
     template<std::size_t nb_bins>
-    std::array<std::size_t,nb_bins> get_histogram() const
+    std::array<std::size_t,nb_bins> get_histogram( std::size_t nb_threads = 1 ) const
     {
-        auto min = *std::min_element( begin(), end() );
-        auto max = *std::max_element( begin(), end() );
-
-        float inv_dynamic = nb_bins / static_cast<float>( max - min );
-        std::array<std::size_t,nb_bins> hist{}; // zero init
-        std::for_each( begin(), end(), [&]( const T& val )
-            {
-                ++hist[ val == max ? nb_bins-1 :
-                	static_cast<std::size_t>( (val-min) * inv_dynamic) ];
-            });
-
-        return hist;
+        return _get_histogram<nb_bins>( std::is_same<T,unsigned char>{}, nb_threads );
     }
 
-    tinymage<T> get_auto_threshold() const
+    tinymage<T> get_auto_threshold(    tinymage_types::threshold_method method = tinymage_types::threshold_method::isodata,
+                                        std::size_t nb_threads = 1 ) const
     {
         tinymage<T> output( *this );
-        output.auto_threshold();
+        output.threshold( static_cast<T>( _auto_threshold_value( method, nb_threads ) ), nb_threads );
         return output;
     }
 
-    void auto_threshold()
+    // value get_auto_threshold would apply, e.g. to threshold other views of the same scene alike
+    int get_auto_threshold_value(   tinymage_types::threshold_method method = tinymage_types::threshold_method::isodata,
+                                    std::size_t nb_threads = 1 ) const
     {
-        // One of the many autothreshold IJ implementations:
-        // https://imagej.nih.gov/ij/developer/source/ij/process/AutoThresholder.java.html
-        int thresh = _default_isodata<256>( get_histogram<256>() );
-        threshold( static_cast<T>( thresh ) );
+        return _auto_threshold_value( method, nb_threads );
     }
 
-    // returns [0...255] clamped image
-    template<typename U = T>
-    tinymage_if_uchar<U> get_sobel() const
+    // morphology with a kx x ky rectangular structuring element, anchored at ( kx/2, ky/2 )
+    // -> van Herk/Gil-Werman separable min/max filters : 3 comparisons per pixel and direction, whatever the element size
+    // -> pixels outside of the image are ignored
+    // -> lines (resp. columns bands) may be filtered concurrently by nb_threads threads
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_erode( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
     {
-        tinymage<T> output( m_width, m_height );
-
-    	T sum;
-        float sumX, sumY;
+        return _morphology( kx, ky, std::numeric_limits<T>::max(), []( T a, T b ) { return std::min( a, b ); }, nb_threads, alloc );
+    }
 
-        // Sobel Matrices Horizontal
-        const float GX[3][3] = {    {   1,  0,  -1  },
-                                    {   2,  0,  -2  },
-                                    {   1,  0,  -1  } };
-        // Sobel Matrices Vertical
-    	const float GY[3][3] = {    {   1,  2,  1   },
-                                    {   0,  0,  0   },
-                                    {   -1, -2, -1  } };
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_dilate( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        return _morphology( kx, ky, std::numeric_limits<T>::lowest(), []( T a, T b ) { return std::max( a, b ); }, nb_threads, alloc );
+    }
 
-    	/*Edge detection */
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_open( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        const auto eroded = get_erode( kx, ky, nb_threads, alloc );
+        return eroded.view().get_dilate( kx, ky, nb_threads, alloc );
+    }
 
-        tinymage_forXY((*this),x,y)
-        {
-			sumX	= 0;
-			sumY	= 0;
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_close( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        const auto dilated = get_dilate( kx, ky, nb_threads, alloc );
+        return dilated.view().get_erode( kx, ky, nb_threads, alloc );
+    }
 
-			/*Image Boundaries*/
-			if( y == 0 || y == m_height - 1 )
-				sum = 0;
-			else if( x == 0 || x == m_width - 1 )
-				sum = 0;
-			else
-			{
-				/*Convolution for X*/
-				for( auto i = -1; i < 2; i++ )
-				{
-					for( auto j = -1; j < 2; j++ )
-					{
-						sumX = sumX + GX[j+1][i+1] * c_at(x+j,y+i);
-					}
-				}
+    // bit-parallel morphology of binary images (any non zero pixel being foreground), output pixels are 0 or 1
+    // -> lines are packed 64 pixels per word, a kx wide window costs log2( kx ) word operations per 64 pixels
+    // -> columns use the same van Herk/Gil-Werman scheme as grayscale images, on whole words
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_binary_erode( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        return _binary_morphology( kx, ky, true, nb_threads, alloc );
+    }
 
-				/*Convolution for Y*/
-				for( auto i = -1; i < 2; i++ )
-				{
-					for( auto j = -1; j < 2; j++ )
-					{
-						sumY = sumY + GY[j+1][i+1] * c_at(x+j,y+i);
-					}
-				}
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_binary_dilate( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        return _binary_morphology( kx, ky, false, nb_threads, alloc );
+    }
 
-				/*Edge strength*/
-				sum = static_cast<T>( std::sqrt( sumX*sumX + sumY*sumY ) );
-                // sum = std::abs(sumX) + std::abs(sumY);
-			}
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_binary_open( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        const auto eroded = get_binary_erode( kx, ky, nb_threads, alloc );
+        return eroded.view().get_binary_dilate( kx, ky, nb_threads, alloc );
+    }
 
-            // clamp range to [0,255]
-    	    output.at(x,y) = sum % 255;
-		}
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_binary_close( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        const auto dilated = get_binary_dilate( kx, ky, nb_threads, alloc );
+        return dilated.view().get_binary_erode( kx, ky, nb_threads, alloc );
+    }
 
+    // separable filter : kernel_x along the lines, then kernel_y along the columns
+    // -> kernel[i] weights the pixel at offset i - N/2 (no flipping), sizes must be odd
+    // -> float accumulation, integer pixels are rounded to nearest and saturated
+    // -> lines are filtered once into a ring of N_y float lines, both passes being vectorized across pixels
+    //    when SSE/AVX2 build options are enabled
+    // -> lines may be filtered concurrently by nb_threads threads
+    template<std::size_t NX, std::size_t NY, typename A = std::allocator<T>>
+    tinymage<T,A> get_convolve( const std::array<float,NX>& kernel_x, const std::array<float,NY>& kernel_y,
+                                tinymage_types::border_policy border = tinymage_types::border_policy::clamp,
+                                std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        tinymage<T,A> output( alloc );
+        convolve_into( output, kernel_x, kernel_y, border, nb_threads );
         return output;
     }
 
-    tinymage<T> get_rotate( float angle, T pad_val = 0 ) const
+    template<std::size_t NX, std::size_t NY, typename A>
+    void convolve_into( tinymage<T,A>& output, const std::array<float,NX>& kernel_x, const std::array<float,NY>& kernel_y,
+                        tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 ) const
     {
-        tinymage<T> output( m_width, m_height, pad_val );
+        static_assert( NX % 2 == 1 && NY % 2 == 1, "kernel sizes must be odd" );
 
-        // define the center of the image, which is the center of rotation.
-        auto horizontal_center = static_cast<float>( m_width / 2 );
-		auto vertical_center = static_cast<float>( m_height / 2 );
+        output.reshape( m_width, m_height );
+        if ( size() == 0 )
+            return;
 
-        // loop through each pixel of the new image, select the new vertical
-        // and horizontal positions, and interpolate the image to make the change.
-        tinymage_forXY( output, x, y )
-        {
-            // figure out how rotated we want the image.
-            auto _rad = angle * m_pi / 180.f;
-            auto horizontal_position = -std::sin(_rad) *
-                ( y - vertical_center ) + std::cos( _rad ) * ( x - horizontal_center )
-                + horizontal_center;
-			auto vertical_position = std::cos(_rad) *
-				( y - vertical_center ) + std::sin( _rad ) * ( x - horizontal_center )
-				+ vertical_center;
+        constexpr std::size_t rx = NX / 2;
+        constexpr std::size_t ry = NY / 2;
 
-            _bilinear_interpolation( output.at( x, y ), horizontal_position, vertical_position );
-        }
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                std::vector<float> padded( m_width + 2*rx );
+                std::vector<float> ring( NY * m_width );
+                std::vector<float> acc( m_width );
 
-        return output;
+                // filters the line at virtual index p (possibly outside of the image) into its ring slot
+                auto _filter_line = [&]( std::ptrdiff_t p )
+                {
+                    float* out = ring.data() + ( ( p + NY*m_height ) % NY ) * m_width;
+                    const auto src_y = _border_index( p, m_height, border );
+                    if ( src_y == m_height )
+                    {
+                        std::fill( out, out + m_width, 0.f );
+                        return;
+                    }
+
+                    const T* in = line( src_y );
+                    std::copy( in, in + m_width, padded.begin() + rx );
+                    _pad_borders( padded.data(), m_width, rx, border );
+
+                    std::array<const float*,NX> taps;
+                    for ( std::size_t i = 0; i < NX; ++i )
+                        taps[i] = padded.data() + i;
+                    _convolve_taps( taps, kernel_x, out, m_width );
+                };
+
+                const auto first = static_cast<std::ptrdiff_t>( start );
+                for ( auto p = first - static_cast<std::ptrdiff_t>( ry ); p < first + static_cast<std::ptrdiff_t>( ry ); ++p )
+                    _filter_line( p );
+
+                for ( auto y = start; y < stop; ++y )
+                {
+                    _filter_line( static_cast<std::ptrdiff_t>( y + ry ) );
+
+                    std::array<const float*,NY> taps;
+                    for ( std::size_t i = 0; i < NY; ++i )
+                        taps[i] = ring.data() + ( ( y + NY*m_height + i - ry ) % NY ) * m_width;
+                    _convolve_taps( taps, kernel_y, acc.data(), m_width );
+                    _store_line( acc.data(), output.line( y ), m_width );
+                }
+            });
     }
 
-    tinymage<T> get_warp(   const tinymage_types::quad_coord_t& in_coords,
-                            const tinymage_types::quad_coord_t& out_coords ) const
-	{
-        // NOTE1:
-        // The homography equations computation is based on :
-        // http://www.corrmap.com/features/homography_transformation.php
-        // NOTE2:
-        // 8x8 Matrix inversion is performed using 4x4 block matrix inversion,
-        // as linalg does not support sizes > 4
-        // https://en.wikipedia.org/wiki/Block_matrix#Block_matrix_inversion
-
-        using namespace linalg::aliases;
+    template<std::size_t R, typename A = std::allocator<T>>
+    tinymage<T,A> get_gaussian( float sigma, tinymage_types::border_policy border = tinymage_types::border_policy::clamp,
+                                std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        const auto kernel = tinymage_types::gaussian_kernel<R>( sigma );
+        return get_convolve( kernel, kernel, border, nb_threads, alloc );
+    }
+
+    // mean over a ( 2*rx+1 ) x ( 2*ry+1 ) window
+    // -> running sums : 2 additions per pixel and direction, whatever the radii
+    // -> column sums are updated line after line, then summed along the line, no intermediate image is needed
+    // -> sums are exact for 8 bits pixels as long as the window holds less than 2^16 pixels
+    // -> lines may be filtered concurrently by nb_threads threads
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_box_blur( std::size_t rx, std::size_t ry, tinymage_types::border_policy border = tinymage_types::border_policy::clamp,
+                                std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        tinymage<T,A> output( alloc );
+        box_blur_into( output, rx, ry, border, nb_threads );
+        return output;
+    }
+
+    template<typename A>
+    void box_blur_into( tinymage<T,A>& output, std::size_t rx, std::size_t ry,
+                        tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 ) const
+    {
+        output.reshape( m_width, m_height );
+        if ( size() == 0 )
+            return;
+
+        const auto norm = 1.f / static_cast<float>( ( 2*rx + 1 ) * ( 2*ry + 1 ) );
+
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                // column sums of the current window, padded on both sides for the line sums
+                std::vector<float> padded( m_width + 2*rx + 1, 0.f );
+                std::vector<float> mean( m_width );
+                float* cols = padded.data() + rx;
+
+                auto _add_line = [&]( std::ptrdiff_t p, float sign )
+                {
+                    const auto src_y = _border_index( p, m_height, border );
+                    if ( src_y == m_height )
+                        return;
+                    const T* in = line( src_y );
+                    for ( std::size_t x = 0; x < m_width; ++x )
+                        cols[x] += sign * static_cast<float>( in[x] );
+                };
+
+                const auto first = static_cast<std::ptrdiff_t>( start );
+                for ( auto p = first - static_cast<std::ptrdiff_t>( ry ); p <= first + static_cast<std::ptrdiff_t>( ry ); ++p )
+                    _add_line( p, 1.f );
+
+                for ( auto y = start; y < stop; ++y )
+                {
+                    _pad_borders( padded.data(), m_width, rx, border );
+
+                    auto sum = std::accumulate( padded.begin(), padded.begin() + 2*rx + 1, 0.f );
+                    for ( std::size_t x = 0; x < m_width; ++x )
+                    {
+                        mean[x] = sum * norm;
+                        sum += padded[x + 2*rx + 1] - padded[x];
+                    }
+                    _store_line( mean.data(), output.line( y ), m_width );
+
+                    _add_line( static_cast<std::ptrdiff_t>( y + ry + 1 ), 1.f );
+                    _add_line( static_cast<std::ptrdiff_t>( y ) - static_cast<std::ptrdiff_t>( ry ), -1.f );
+                }
+            });
+    }
+
+    // half resolution image, output is (re)allocated only if its size does not match
+    // -> output lines may be computed concurrently by nb_threads threads
+    template<typename A>
+    void pyr_down_into( tinymage<T,A>& output, tinymage_types::pyramid_filter filter = tinymage_types::pyramid_filter::box,
+                        std::size_t nb_threads = 1 ) const
+    {
+        assert( m_width >= 2 && m_height >= 2 );
+
+        const auto nsx = m_width / 2;
+        const auto nsy = m_height / 2;
+        if ( output.width() != nsx || output.height() != nsy )
+            output = tinymage<T,A>( nsx, nsy, 0, output.get_allocator() );
+
+        // integer pixels are rounded to nearest
+        const auto round = std::is_integral<T>::value ? 0.5f : 0.f;
+
+        tinyutils::parallel_for( nsy, output.view()._nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    T* out = output.line( y );
+                    if ( filter == tinymage_types::pyramid_filter::box )
+                    {
+                        const T* l0 = line( 2*y );
+                        const T* l1 = line( 2*y + 1 );
+                        for ( std::size_t x = 0; x < nsx; ++x )
+                            out[x] = static_cast<T>( 0.25f * ( static_cast<float>( l0[2*x] ) + l0[2*x+1] + l1[2*x] + l1[2*x+1] ) + round );
+                    }
+                    else
+                    {
+                        // first line and column are clamped, 2*i+1 always lies in the image
+                        const T* lines[3] = { line( y > 0 ? 2*y - 1 : 0 ), line( 2*y ), line( 2*y + 1 ) };
+                        for ( std::size_t x = 0; x < nsx; ++x )
+                        {
+                            const auto xl = x > 0 ? 2*x - 1 : 0;
+                            auto sum = 0.f;
+                            for ( auto j = 0; j < 3; ++j )
+                                sum += ( j == 1 ? 2.f : 1.f ) * ( static_cast<float>( lines[j][xl] ) + 2.f * lines[j][2*x] + lines[j][2*x+1] );
+                            out[x] = static_cast<T>( sum / 16.f + round );
+                        }
+                    }
+                }
+            });
+    }
+
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_pyr_down( tinymage_types::pyramid_filter filter = tinymage_types::pyramid_filter::box,
+                                std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        tinymage<T,A> output( alloc );
+        pyr_down_into( output, filter, nb_threads );
+        return output;
+    }
+
+    // returns [0...255] clamped image
+    // -> separable integer kernel on interior lines, vectorized when SSE/AVX2 build options are enabled
+    // -> interior lines may be processed concurrently by nb_threads threads
+    template<typename U = T, typename A = std::allocator<T>>
+    tinymage_if_uchar<U,A> get_sobel( std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        tinymage<T,A> output( m_width, m_height, 0, alloc ); // image boundaries are left to zero
+
+        if ( m_width < 3 || m_height < 3 )
+            return output;
+
+        tinyutils::parallel_for( m_height - 2, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start + 1; y < stop + 1; ++y )
+                    _sobel_line( line( y-1 ), line( y ), line( y+1 ), output.line( y ), m_width );
+            });
+
+        return output;
+    }
+
+    // max magnitude of get_sobel, lines of edges being computed on the fly and never stored
+    // -> magnitudes are clamped, so the scan stops as soon as any band meets a 255 one, as contrasted frames do early
+    template<typename U = T>
+    std::enable_if_t<std::is_same<U, unsigned char>::value, T> get_sobel_max( std::size_t nb_threads = 1 ) const
+    {
+        T max = 0;
+        if ( m_width < 3 || m_height < 3 )
+            return max;
+
+        std::mutex max_mutex;
+        std::atomic<bool> saturated{ false };
+        tinyutils::parallel_for( m_height - 2, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                std::vector<T> edges( m_width, 0 );
+                T band_max = 0;
+                for ( auto y = start + 1; y < stop + 1 && !saturated.load( std::memory_order_relaxed ); ++y )
+                {
+                    _sobel_line( line( y-1 ), line( y ), line( y+1 ), edges.data(), m_width );
+                    band_max = std::max( band_max, _max_above( edges.data(), m_width ) );
+                    if ( band_max == 255 )
+                        saturated = true;
+                }
+
+                std::lock_guard<std::mutex> lock( max_mutex );
+                max = std::max( max, band_max );
+            });
+
+        return max;
+    }
+
+    // counts of get_sobel magnitudes above thresh, per line ( 1 x height ) and per column ( width x 1 ),
+    // same as tinymage_binary( get_sobel(), thresh ).line_row_sums()
+    // -> each line of edges is computed, compared and counted while in cache, no intermediate image is allocated
+    // -> columns are counted in 8 bits lanes, flushed every 255 lines, lines bands may be counted concurrently
+    // -> both projections are allocated by alloc, the per band scratch lines by the heap as bands may run on pool threads
+    template<typename U = T, typename F = float, typename A = std::allocator<F>>
+    std::enable_if_t<std::is_same<U, unsigned char>::value, std::pair<tinymage<F,A>,tinymage<F,A>>>
+    get_sobel_line_row_sums( T thresh, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        auto outputs = std::make_pair( tinymage<F,A>( 1, m_height, 0.f, alloc ), tinymage<F,A>( m_width, 1, 0.f, alloc ) );
+        if ( m_width < 3 || m_height < 3 || thresh == 255 )
+            return outputs;
+
+        std::mutex sums_mutex;
+        tinyutils::parallel_for( m_height - 2, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                std::vector<T> edges( m_width, 0 );
+                std::vector<uint8_t> counts( m_width, 0 );
+                std::vector<std::size_t> band_sums( m_width, 0 );
+
+                auto flush = [&]()
+                    {
+                        for ( std::size_t x = 0; x < m_width; ++x )
+                            band_sums[x] += counts[x];
+                        std::fill( counts.begin(), counts.end(), 0 );
+                    };
+
+                std::size_t pending = 0;
+                for ( auto y = start + 1; y < stop + 1; ++y )
+                {
+                    _sobel_line( line( y-1 ), line( y ), line( y+1 ), edges.data(), m_width );
+                    outputs.first[y] = static_cast<F>( _count_above( edges.data(), thresh, counts.data(), m_width ) );
+                    if ( ++pending == 255 )
+                    {
+                        flush();
+                        pending = 0;
+                    }
+                }
+                flush();
+
+                std::lock_guard<std::mutex> lock( sums_mutex );
+                for ( std::size_t x = 0; x < m_width; ++x )
+                    outputs.second[x] += static_cast<F>( band_sums[x] );
+            });
+
+        return outputs;
+    }
+
+    // scalar reference implementation of get_sobel, kept for verification purpose
+    template<typename U = T>
+    tinymage_if_uchar<U> get_sobel_ref() const
+    {
         tinymage<T> output( m_width, m_height );
 
-        float4 x( std::get<0>(in_coords).first, std::get<1>(in_coords).first, std::get<2>(in_coords).first, std::get<3>(in_coords).first );
-        float4 y( std::get<0>(in_coords).second, std::get<1>(in_coords).second, std::get<2>(in_coords).second, std::get<3>(in_coords).second );
-        float4 X( std::get<0>(out_coords).first, std::get<1>(out_coords).first, std::get<2>(out_coords).first, std::get<3>(out_coords).first );
-        float4 Y( std::get<0>(out_coords).second, std::get<1>(out_coords).second, std::get<2>(out_coords).second, std::get<3>(out_coords).second );
-
-        // initialize transformation matrix (!!column major order!!)
-        float4x4 hA, hB, hC, hD;
-        hA = { x, y, { 1.f, 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f, 0.f } };
-        hB = { { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, -x*X, -y*X };
-        hC = { { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, x };
-        hD = { y, { 1.f, 1.f, 1.f, 1.f }, -x*Y, -y*Y };
-
-        // invert transformation matrix
-        float4x4 ihA, ihB, ihC, ihD;
-
-        // compute block inverse homography matrix
-        auto invhD = inverse( hD );
-        ihA = inverse( hA - mul( hB, mul( invhD, hC ) ) );
-        ihB = mul( -ihA, mul( hB, invhD ) );
-        ihC = mul( -invhD, mul( hC, ihA ) );
-        ihD = invhD - mul( ihC, mul( hB, invhD ) );
-
-        // compute transformation parameters vector
-        float4 abcd = mul( ihA, X ) + mul( ihB, Y );
-        auto a = abcd[0], b = abcd[1], c = abcd[2], d = abcd[3];
-        float4 efgh = mul( ihC, X ) + mul( ihD, Y );
-        auto e = efgh[0], f = efgh[1], g = efgh[2], h = efgh[3];
-
-        // invert 3x3 homography matrix
-        float3x3 homog = inverse( float3x3{{a,d,g},{b,e,h},{c,f,1.f}} );
-        a = homog[0][0], d = homog[0][1], g = homog[0][2], b = homog[1][0];
-        e = homog[1][1], h = homog[1][2], c = homog[2][0], f = homog[2][1];
-
-        auto homoX = [a,b,c,g,h]( const float& _x, const float& _y ) {
-                return ( a*_x + b*_y + c ) / ( g*_x + h*_y + 1.f );
-        };
+    	T sum;
+        float sumX, sumY;
 
-        auto homoY = [d,e,f,g,h]( const float& _x, const float& _y ) {
-                return ( d*_x + e*_y + f ) / ( g*_x + h*_y + 1.f );
-        };
+        // Sobel Matrices Horizontal
+        const float GX[3][3] = {    {   1,  0,  -1  },
+                                    {   2,  0,  -2  },
+                                    {   1,  0,  -1  } };
+        // Sobel Matrices Vertical
+    	const float GY[3][3] = {    {   1,  2,  1   },
+                                    {   0,  0,  0   },
+                                    {   -1, -2, -1  } };
+
+    	/*Edge detection */
 
-        tinymage_forXY(output,X,Y)
+        tinymage_forXY((*this),x,y)
         {
-            _bilinear_interpolation( output.at( X, Y ), homoX( X, Y ), homoY( X, Y ) );
-        }
+			sumX	= 0;
+			sumY	= 0;
+
+			/*Image Boundaries*/
+			if( y == 0 || y == m_height - 1 )
+				sum = 0;
+			else if( x == 0 || x == m_width - 1 )
+				sum = 0;
+			else
+			{
+				/*Convolution for X*/
+				for( auto i = -1; i < 2; i++ )
+				{
+					for( auto j = -1; j < 2; j++ )
+					{
+						sumX = sumX + GX[j+1][i+1] * c_at(x+j,y+i);
+					}
+				}
+
+				/*Convolution for Y*/
+				for( auto i = -1; i < 2; i++ )
+				{
+					for( auto j = -1; j < 2; j++ )
+					{
+						sumY = sumY + GY[j+1][i+1] * c_at(x+j,y+i);
+					}
+				}
+
+				/*Edge strength, clamped to [0,255]*/
+				sum = static_cast<T>( std::min( std::sqrt( sumX*sumX + sumY*sumY ), 255.f ) );
+                // sum = std::abs(sumX) + std::abs(sumY);
+			}
+
+    	    output.at(x,y) = sum;
+		}
 
         return output;
+    }
+
+    // rows may be resampled concurrently by nb_threads threads
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_rotate( float angle, T pad_val = 0, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        return get_transform( tinymage_types::transform_t::rotation( angle, m_width, m_height ), pad_val, nb_threads, alloc );
+    }
+
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_warp( const tinymage_types::quad_coord_t& in_coords,
+                            const tinymage_types::quad_coord_t& out_coords,
+                            std::size_t nb_threads = 1,
+                            const A& alloc = A() ) const
+	{
+        return get_transform( tinymage_types::transform_t::homography( in_coords, out_coords ), 0, nb_threads, alloc );
 	}
 
+    template<typename A>
+    void warp_into( tinymage<T,A>& output,
+                    const tinymage_types::quad_coord_t& in_coords,
+                    const tinymage_types::quad_coord_t& out_coords,
+                    std::size_t nb_threads = 1 ) const
+    {
+        transform_into( output, tinymage_types::transform_t::homography( in_coords, out_coords ), 0, nb_threads );
+    }
+
+    // bilinear resampling engine shared by all geometric transforms
+    // -> the transform is evaluated once per line, source coordinates are then linear along the line
+    // -> output pixels mapped outside of the source image are set to pad_val
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> get_transform(    const tinymage_types::transform_t& tr, T pad_val = 0, std::size_t nb_threads = 1,
+                                    const A& alloc = A() ) const
+    {
+        tinymage<T,A> output( alloc );
+        transform_into( output, tr, pad_val, nb_threads );
+        return output;
+    }
+
+    template<typename A>
+    void transform_into( tinymage<T,A>& output, const tinymage_types::transform_t& tr, T pad_val = 0, std::size_t nb_threads = 1 ) const
+    {
+        output.reshape( m_width, m_height );
+
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    std::fill( output.line( y ), output.line( y ) + m_width, pad_val );
+                    if ( tr.is_affine() )
+                        _transform_line<false>( tr, y, output.line( y ), m_width );
+                    else
+                        _transform_line<true>( tr, y, output.line( y ), m_width );
+                }
+            });
+    }
+
     void display() const
     {
-#ifdef USE_CIMG
-        const cimg_library::CImg<T> cimg( data(), static_cast<int>( m_width ), static_cast<int>( m_height ), 1, 1, true/*shared*/ );
-        cimg.display();
-#else
-        // NOT IMPLEMENTED YET
-#endif
+        materialize().display();
     }
 
 private:
+    const T* m_data;
     std::size_t m_width;
     std::size_t m_height;
+    std::size_t m_stride;
 
-    constexpr static T m_zero{ 0 };
-    constexpr static T m_one{ 1 };
-	constexpr static float m_pi{ 3.14159265358979323846f };
-
-	// gcc does compile this, but acos being constexpr compatible is not in the standard!
-	// https://stackoverflow.com/questions/32814678/constexpr-compile-error-with-clang-not-g
-    // constexpr static float m_pi{ std::acos( -1.f ) };
+    // minimal number of pixels processed by each thread in tinymage_types::auto_threads mode
+    constexpr static std::size_t m_min_task_size{ 128*128 };
 
 private:
 
-    void _normalize( tinymage<T>& input, T min, T max ) const
+    // resolves the threads count of an operation on this view
+    std::size_t _nb_tasks( std::size_t nb_threads ) const
     {
-        assert( max > min );
+        if ( nb_threads != tinymage_types::auto_threads )
+            return nb_threads;
+        return std::max( std::size_t(1), std::min( tinyutils::hardware_tasks(), size() / m_min_task_size ) );
+    }
 
-        auto cur_min = *std::min_element( begin(), end() );
-        auto cur_max = *std::max_element( begin(), end() );
+    // separable min/max filter, pad being the op neutral value
+    template<typename A, typename Op>
+    tinymage<T,A> _morphology( std::size_t kx, std::size_t ky, T pad, Op op, std::size_t nb_threads, const A& alloc ) const
+    {
+        assert( kx > 0 && ky > 0 );
 
-        assert( cur_max > cur_min );
+        const auto nb_tasks = _nb_tasks( nb_threads );
 
-        double cur_dyn = cur_max - cur_min;
-        double out_dyn = max - min;
+        tinymage<T,A> horizontal( m_width, m_height, 0, alloc );
+        tinyutils::parallel_for( m_height, nb_tasks, [&]( std::size_t start, std::size_t stop )
+            {
+                std::vector<T> g, h;
+                for ( auto y = start; y < stop; ++y )
+                    _vhgw_line( line( y ), horizontal.line( y ), m_width, kx, pad, op, g, h );
+            });
 
-        std::for_each( input.begin(), input.end(), [&]( T& val )
+        tinymage<T,A> output( m_width, m_height, 0, alloc );
+        tinyutils::parallel_for( m_width, nb_tasks, [&]( std::size_t start, std::size_t stop )
             {
-                val = static_cast<T>( min + ( out_dyn * ( val - cur_min ) / cur_dyn ) );
+                _vhgw_columns( m_height, stop - start, ky, pad, op,
+                    [&]( std::size_t y ) -> const T* { return horizontal.line( y ) + start; },
+                    [&]( std::size_t y ) { return output.line( y ) + start; } );
             });
+
+        return output;
     }
 
-    template<std::size_t length>
-    int _default_isodata( const std::array<std::size_t,length>& data )
+    // van Herk/Gil-Werman : the k wide window at i spans at most two k aligned blocks of the padded line,
+    // -> so it is the op of a block suffix (h) and of a block prefix (g), both computed once per element
+    template<typename U, typename Op>
+    static void _vhgw_line( const U* in, U* out, std::size_t n, std::size_t k, U pad, Op op, std::vector<U>& g, std::vector<U>& h )
     {
-        std::array<std::size_t,length> data2;
-        std::size_t mode=0, maxCount=0, maxCount2=0;
-        for ( auto i=std::size_t(0); i<length; i++ ) {
-            data2[i] = data[i];
-            if ( data2[i]>maxCount ) {
-                maxCount = data2[i];
-                mode = i;
-            }
-        }
-        for ( auto i=std::size_t(0); i<length; i++ ) {
-            if ((data2[i]>maxCount2) && (i!=mode))
-                maxCount2 = data2[i];
+        const auto r = k / 2;
+        const auto m = ( n + 2*k - 2 ) / k * k; // n + k - 1 padded elements, rounded to whole blocks
+        g.resize( m );
+        h.resize( m );
+
+        auto ext = [&]( std::size_t j ) { return ( j >= r && j - r < n ) ? in[j - r] : pad; };
+        for ( std::size_t b = 0; b < m; b += k )
+        {
+            g[b] = ext( b );
+            for ( auto j = b + 1; j < b + k; ++j )
+                g[j] = op( g[j-1], ext( j ) );
+            h[b+k-1] = ext( b+k-1 );
+            for ( auto j = b + k - 1; j-- > b; )
+                h[j] = op( h[j+1], ext( j ) );
         }
-        auto hmax = maxCount;
-        if ( (hmax>(maxCount2*2)) && (maxCount2!=0) ) {
-            hmax = static_cast<int>( maxCount2 * 1.5 );
-            data2[mode] = hmax;
+
+        for ( std::size_t i = 0; i < n; ++i )
+            out[i] = op( h[i], g[i + k - 1] );
+    }
+
+    // same as _vhgw_line along columns, whole lines of w elements being processed at once
+    template<typename U, typename Op, typename In, typename Out>
+    static void _vhgw_columns( std::size_t n, std::size_t w, std::size_t k, U pad, Op op, In in_line, Out out_line )
+    {
+        const auto r = k / 2;
+        const auto m = ( n + 2*k - 2 ) / k * k;
+        std::vector<U> g( m*w ), h( m*w );
+        const std::vector<U> pad_line( w, pad );
+
+        auto ext = [&]( std::size_t j ) -> const U* { return ( j >= r && j - r < n ) ? in_line( j - r ) : pad_line.data(); };
+        auto combine = [&]( U* dst, const U* a, const U* b ) {
+            for ( std::size_t x = 0; x < w; ++x )
+                dst[x] = op( a[x], b[x] );
+        };
+        for ( std::size_t b = 0; b < m; b += k )
+        {
+            std::copy( ext( b ), ext( b ) + w, &g[b*w] );
+            for ( auto j = b + 1; j < b + k; ++j )
+                combine( &g[j*w], &g[(j-1)*w], ext( j ) );
+            std::copy( ext( b+k-1 ), ext( b+k-1 ) + w, &h[(b+k-1)*w] );
+            for ( auto j = b + k - 1; j-- > b; )
+                combine( &h[j*w], &h[(j+1)*w], ext( j ) );
         }
-        return _isodata<length>( data2 );
+
+        for ( std::size_t i = 0; i < n; ++i )
+            combine( out_line( i ), &h[i*w], &g[(i + k - 1)*w] );
     }
 
-    // Warning : will modify data array
-    template<std::size_t length>
-    int _isodata( std::array<std::size_t,length>& data )
+    template<typename A>
+    tinymage<T,A> _binary_morphology( std::size_t kx, std::size_t ky, bool erode, std::size_t nb_threads, const A& alloc ) const
     {
-        data.front() = 0; //set to zero so erased areas aren't included
-        data.back() = 0;
+        assert( kx > 0 && ky > 0 );
 
-        auto maxValue = length - 1;
+        // pixels outside of the image are ignored : set for erosion, cleared for dilation
+        const uint64_t fill = erode ? ~uint64_t(0) : 0;
+        auto op = [erode]( uint64_t a, uint64_t b ) { return erode ? a & b : a | b; };
 
-        auto min = std::size_t{0};
-        while ( (data[min]==0) && (min<maxValue) ) min++;
-        auto max = maxValue;
-        while ( (data[max]==0) && (max>0) ) max--;
-        if ( min>=max )
-            return static_cast<int>( length / 2 );
+        const auto nb_tasks = _nb_tasks( nb_threads );
+        const auto words = ( m_width + 63 ) / 64;
 
-        double result, sum1, sum2, sum3, sum4;
+        // lines are first moved by the anchor offset, so the extended words also hold the kx/2 last pixels
+        const auto anchor = kx / 2;
+        const auto ext_words = ( m_width + anchor + 63 ) / 64;
 
-        auto movingIndex = min;
-        do {
-            sum1=sum2=sum3=sum4=0.0;
-            for ( auto i=min; i<=movingIndex; i++ ) {
-                sum1 += static_cast<double>(i*data[i]);
-                sum2 += data[i];
-            }
-            for ( auto i=(movingIndex+1); i<=max; i++) {
-                sum3 += static_cast<double>(i*data[i]);
-                sum4 += data[i];
-            }
-            result = (sum1/sum2 + sum3/sum4)/2.0;
-            movingIndex++;
-        } while ( ( movingIndex + 1 ) <= result && movingIndex < max - 1 );
+        // packing and horizontal filtering, line by line
+        std::vector<uint64_t> horizontal( words * m_height );
+        tinyutils::parallel_for( m_height, nb_tasks, [&]( std::size_t start, std::size_t stop )
+            {
+                std::vector<uint64_t> packed( ext_words ), window( ext_words ), tmp( ext_words );
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const T* in = line( y );
+                    for ( std::size_t i = 0; i < ext_words; ++i )
+                    {
+                        uint64_t word = fill;
+                        for ( std::size_t b = 0, x = 64*i; b < 64 && x < m_width; ++b, ++x )
+                            word = in[x] ? word | ( uint64_t(1) << b ) : word & ~( uint64_t(1) << b );
+                        packed[i] = word;
+                    }
+
+                    // window bit x is then the op of bits [x...x+kx) : pixels [x-kx/2...x-kx/2+kx)
+                    _shift_bits( packed.data(), window.data(), ext_words, -static_cast<std::ptrdiff_t>( anchor ), fill );
+
+                    // windows are doubled up to the largest power of two c <= kx : S_2c(x) = S_c(x) op S_c(x+c),
+                    // -> then S_kx(x) = S_c(x) op S_c(x+kx-c)
+                    std::size_t c = 1;
+                    for ( ; 2*c <= kx; c *= 2 )
+                    {
+                        _shift_bits( window.data(), tmp.data(), ext_words, static_cast<std::ptrdiff_t>( c ), fill );
+                        for ( std::size_t i = 0; i < ext_words; ++i )
+                            window[i] = op( window[i], tmp[i] );
+                    }
+                    if ( c < kx )
+                    {
+                        _shift_bits( window.data(), tmp.data(), ext_words, static_cast<std::ptrdiff_t>( kx - c ), fill );
+                        for ( std::size_t i = 0; i < ext_words; ++i )
+                            window[i] = op( window[i], tmp[i] );
+                    }
+
+                    std::copy( window.begin(), window.begin() + words, &horizontal[words*y] );
+                }
+            });
 
-        return static_cast<int>( std::round( result ) );
+        std::vector<uint64_t> vertical( words * m_height );
+        tinyutils::parallel_for( words, nb_tasks, [&]( std::size_t start, std::size_t stop )
+            {
+                _vhgw_columns( m_height, stop - start, ky, fill, op,
+                    [&]( std::size_t y ) -> const uint64_t* { return &horizontal[words*y + start]; },
+                    [&]( std::size_t y ) { return &vertical[words*y + start]; } );
+            });
+
+        tinymage<T,A> output( m_width, m_height, 0, alloc );
+        tinyutils::parallel_for( m_height, nb_tasks, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const uint64_t* bits = &vertical[words*y];
+                    T* out = output.line( y );
+                    for ( std::size_t x = 0; x < m_width; ++x )
+                        out[x] = ( bits[x/64] >> ( x%64 ) ) & 1 ? T{1} : T{0};
+                }
+            });
+
+        return output;
     }
 
-    void _bilinear_interpolation( T& out, float horizontal_position, float vertical_position ) const
+    // dst bit x = src bit x+t ( t < 0 moving bits towards the line end ), fill being read outside of the words
+    static void _shift_bits( const uint64_t* src, uint64_t* dst, std::size_t words, std::ptrdiff_t t, uint64_t fill )
     {
-        // figure out the four locations (and then, four pixels)
-        // that we must interpolate from the original image.
-        auto top = static_cast<std::ptrdiff_t>( std::floor( vertical_position ) );
-        auto bottom = top + 1;
-        auto left = static_cast<std::ptrdiff_t>( std::floor( horizontal_position ) );
-        auto right = left + 1;
+        const auto nb_words = static_cast<std::ptrdiff_t>( words );
+        auto word = [&]( std::ptrdiff_t i ) { return ( i >= 0 && i < nb_words ) ? src[i] : fill; };
 
-        // check if any of the four locations are invalid. If they are,
-        // skip interpolating this pixel. Otherwise, interpolate the
-        // pixel according to the dimensions set above and set the
-        // resulting pixel.
-        if ( top >= 0 && bottom < static_cast<std::ptrdiff_t>( m_height ) &&
-            left >= 0 && right < static_cast<std::ptrdiff_t>( m_width ) )
+        const auto q = ( t >= 0 ? t : -t ) / 64;
+        const auto s = ( t >= 0 ? t : -t ) % 64;
+        for ( std::ptrdiff_t i = 0; i < nb_words; ++i )
         {
-            out = _bilinear_interpolation( top, bottom,
-                left, right, horizontal_position, vertical_position );
+            if ( t >= 0 )
+                dst[i] = s ? ( word( i+q ) >> s ) | ( word( i+q+1 ) << ( 64-s ) ) : word( i+q );
+            else
+                dst[i] = s ? ( word( i-q ) << s ) | ( word( i-q-1 ) >> ( 64-s ) ) : word( i-q );
         }
     }
 
-    T _bilinear_interpolation(  std::ptrdiff_t top, std::ptrdiff_t bottom, std::ptrdiff_t left, std::ptrdiff_t right,
-                                float horizontal_position, float vertical_position ) const
+    // stb resampling of each output lines band, as a region of the full source to output mapping
+    // -> a single band is exactly stbir_resize_uint8/float, band edges may differ from it by rounding only
+    template<typename D>
+    void _resize_into( D& output, stbir_datatype type, std::size_t nb_threads ) const
     {
-        // figure out "how far" the output pixel being considered is between *_left and *_right.
-        auto horizontal_progress = horizontal_position - left;
-        auto vertical_progress = vertical_position - top;
+        const auto nsx = output.width();
+        const auto nsy = output.height();
 
-        // combine top_left and top_right into one large, horizontal block.
-        auto top_block = c_at( left, top ) + horizontal_progress * ( c_at( right, top) - c_at( left, top ) );
+        tinyutils::parallel_for( nsy, output.view()._nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                stbir_resize_region( data(), static_cast<int>( m_width ), static_cast<int>( m_height ), static_cast<int>( m_stride * sizeof(T) ),
+                    output.line( start ), static_cast<int>( nsx ), static_cast<int>( stop - start ), static_cast<int>( output.stride() * sizeof(T) ),
+                    type, 1, -1, 0, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                    STBIR_COLORSPACE_LINEAR, nullptr,
+                    0.f, static_cast<float>( start ) / nsy, 1.f, static_cast<float>( stop ) / nsy );
+            });
+    }
 
-        // combine bottom_left and bottom_right into one large, horizontal block.
-        auto bottom_block = c_at( left, bottom ) + horizontal_progress * ( c_at( right, bottom ) - c_at( left, bottom ) );
+    template<typename R>
+    static void _convert_line( const T* in, R* out, std::size_t width )
+    {
+        std::copy( in, in + width, out );
+    }
 
-        // combine the top_block and bottom_block using vertical interpolation and return as the resulting pixel.
-        return static_cast<T>( top_block + vertical_progress * ( bottom_block - top_block ) );
+    static void _convert_line( const float* in, unsigned char* out, std::size_t width )
+    {
+        std::size_t x = 0;
+#if defined(TINYMAGE_USE_AVX2)
+        // packs work in-lane, the 32 bits groups are put back in order by a final permutation
+        const auto order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+        for ( ; x + 32 <= width; x += 32 )
+        {
+            auto convert = [&]( std::size_t i ) { return _mm256_cvttps_epi32( _mm256_loadu_ps( in + x + i ) ); };
+            const auto lo = _mm256_packs_epi32( convert( 0 ), convert( 8 ) );
+            const auto hi = _mm256_packs_epi32( convert( 16 ), convert( 24 ) );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>( out + x ),
+                _mm256_permutevar8x32_epi32( _mm256_packus_epi16( lo, hi ), order ) );
+        }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        for ( ; x + 16 <= width; x += 16 )
+        {
+            auto convert = [&]( std::size_t i ) { return _mm_cvttps_epi32( _mm_loadu_ps( in + x + i ) ); };
+            const auto lo = _mm_packs_epi32( convert( 0 ), convert( 4 ) );
+            const auto hi = _mm_packs_epi32( convert( 8 ), convert( 12 ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + x ), _mm_packus_epi16( lo, hi ) );
+        }
+#endif
+        // NaN gives 0, as the SIMD conversions do
+        for ( ; x < width; ++x )
+            out[x] = in[x] > 0.f ? ( in[x] < 255.f ? static_cast<unsigned char>( in[x] ) : 255 ) : 0;
     }
 
- private:
+    // max of the [1...width-2] interior pixels
+    static T _max_above( const T* in, std::size_t width )
+    {
+        T max = 0;
+        std::size_t x = 1UL;
+
+#if defined(TINYMAGE_USE_AVX2)
+        auto max32 = _mm256_setzero_si256();
+        for ( ; x + 32 < width; x += 32 )
+            max32 = _mm256_max_epu8( max32, _mm256_loadu_si256( reinterpret_cast<const __m256i*>( in + x ) ) );
+        alignas(32) T lanes[32];
+        _mm256_store_si256( reinterpret_cast<__m256i*>( lanes ), max32 );
+        max = *std::max_element( lanes, lanes + 32 );
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        auto max16 = _mm_setzero_si128();
+        for ( ; x + 16 < width; x += 16 )
+            max16 = _mm_max_epu8( max16, _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + x ) ) );
+        alignas(16) T lanes16[16];
+        _mm_store_si128( reinterpret_cast<__m128i*>( lanes16 ), max16 );
+        max = std::max( max, *std::max_element( lanes16, lanes16 + 16 ) );
+#endif
+        for ( ; x < width - 1; ++x )
+            max = std::max( max, in[x] );
 
-     template <typename F>
-     friend tinymage<F> operator-( const F& val, const tinymage<F>& t );
-};
+        return max;
+    }
 
-template <typename T>
-inline tinymage<T> operator-( const T& val, const tinymage<T>& t )
-{
-    tinymage<T> output( t );
-    std::for_each( output.begin(), output.end(), [&]( T& tval )
+    // number of the [1...width-2] interior pixels above thresh, whose counts are also incremented
+    // NOTE : thresh must be below 255, counts must not overflow
+    static std::size_t _count_above( const T* in, T thresh, uint8_t* counts, std::size_t width )
+    {
+        std::size_t count = 0;
+        std::size_t x = 1UL;
+
+#if defined(TINYMAGE_USE_AVX2)
+        // unsigned in > thresh is max( in, thresh+1 ) == in, the all ones lanes decrementing the counters
+        const auto min8 = _mm256_set1_epi8( static_cast<char>( thresh + 1 ) );
+        for ( ; x + 32 < width; x += 32 )
         {
-            tval = val - tval;
-        });
-    return output;
-}
+            const auto val = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( in + x ) );
+            const auto above = _mm256_cmpeq_epi8( _mm256_max_epu8( val, min8 ), val );
+            count += tinyutils::popcount( static_cast<uint32_t>( _mm256_movemask_epi8( above ) ) );
+            auto* cnt = reinterpret_cast<__m256i*>( counts + x );
+            _mm256_storeu_si256( cnt, _mm256_sub_epi8( _mm256_loadu_si256( cnt ), above ) );
+        }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        const auto min16 = _mm_set1_epi8( static_cast<char>( thresh + 1 ) );
+        for ( ; x + 16 < width; x += 16 )
+        {
+            const auto val = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + x ) );
+            const auto above = _mm_cmpeq_epi8( _mm_max_epu8( val, min16 ), val );
+            count += tinyutils::popcount( static_cast<uint32_t>( _mm_movemask_epi8( above ) ) );
+            auto* cnt = reinterpret_cast<__m128i*>( counts + x );
+            _mm_storeu_si128( cnt, _mm_sub_epi8( _mm_loadu_si128( cnt ), above ) );
+        }
+#endif
+        for ( ; x < width - 1; ++x )
+        {
+            const bool above = in[x] > thresh;
+            count += above;
+            counts[x] += above;
+        }
+
+        return count;
+    }
+
+    // generic line moments sums
+    // -> zero pixels add nothing, the bounds being updated with conditional moves rather than unpredictable branches
+    template<typename U>
+    static tinymage_types::line_moments_t _get_line_moments( const U* in, std::size_t width )
+    {
+        tinymage_types::line_moments_t sums{ 0., 0., 0., width, 0 };
+        for ( std::size_t x = 0; x < width; ++x )
+        {
+            const auto val = static_cast<double>( in[x] );
+            const auto fx = static_cast<double>( x );
+            sums.s += val;
+            sums.sx += fx * val;
+            sums.sxx += fx * fx * val;
+            const bool non_zero = in[x] != U(0);
+            sums.first = ( non_zero && sums.first == width ) ? x : sums.first;
+            sums.last = non_zero ? x : sums.last;
+        }
+        return sums;
+    }
+
+    // 8 bits line moments sums, exact as accumulated on integers
+    // -> SIMD loops process chunks of n blocks of bw pixels from c, x being c + bw.b + i : the block sums s, p and q
+    //    of I, i.I and i^2.I are vectorized, the b.s, b^2.s and b.p chunk sums being recovered from running sums
+    // -> all zero blocks, frequent around digits, only update the running sums
+    static tinymage_types::line_moments_t _get_line_moments( const unsigned char* in, std::size_t width )
+    {
+        std::int64_t s = 0, sx = 0, sxx = 0;
+        std::size_t first = width, last = 0;
+        std::size_t x = 0;
+
+#if defined(TINYMAGE_USE_SSE)
+        // S, P and Q are the chunk sums of s, p and q, U and V the sums of the running sums of s and p,
+        // W the sum of the running sums of U : U = sum of (n-b).s and W = sum of (n-b).(n-b+1)/2.s
+        auto fold = [&]( std::int64_t c, std::int64_t n, std::int64_t bw,
+                         std::int64_t S, std::int64_t P, std::int64_t Q, std::int64_t U, std::int64_t V, std::int64_t W )
+            {
+                const auto bs = n * S - U;                          // sum of b.s
+                const auto b2s = n * n * S - 2 * n * U + 2 * W - U; // sum of b^2.s
+                const auto bp = n * P - V;                          // sum of b.p
+                s += S;
+                sx += c * S + bw * bs + P;
+                sxx += c * c * S + 2 * c * bw * bs + bw * bw * b2s + 2 * c * P + 2 * bw * bp + Q;
+            };
+
+        // first and last non zero pixels, from the non zero bytes mask of a block
+        auto bounds = [&]( std::size_t x0, std::uint64_t mask )
+            {
+                if ( first == width )
+                    first = x0 + tinyutils::count_trailing_zeros( mask );
+                last = x0 + 63 - tinyutils::count_leading_zeros( mask );
+            };
+#endif
+
+#if defined(TINYMAGE_USE_AVX2)
+        {
+            // 32 pixels blocks, at most 32 by chunk so that the 32 bits running sums cannot overflow
+            const auto zero = _mm256_setzero_si256();
+            const auto ones = _mm256_set1_epi16( 1 );
+            const auto i_lo = _mm256_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 );
+            const auto i_hi = _mm256_setr_epi16( 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 );
+            const auto i2_lo = _mm256_setr_epi16( 0, 1, 4, 9, 16, 25, 36, 49, 64, 81, 100, 121, 144, 169, 196, 225 );
+            const auto i2_hi = _mm256_setr_epi16( 256, 289, 324, 361, 400, 441, 484, 529, 576, 625, 676, 729, 784, 841, 900, 961 );
+            auto reduce = []( __m256i sums )
+                {
+                    alignas(32) std::int32_t lanes[8];
+                    _mm256_store_si256( reinterpret_cast<__m256i*>( lanes ), sums );
+                    return std::accumulate( lanes, lanes + 8, std::int64_t(0) );
+                };
+
+            while ( x + 32 <= width )
+            {
+                const auto c = x;
+                const auto n = std::min( ( width - x ) / 32, std::size_t(32) );
+                auto s32 = zero, p32 = zero, q32 = zero, u32 = zero, v32 = zero, w32 = zero;
+                for ( std::size_t b = 0; b < n; ++b, x += 32 )
+                {
+                    const auto val = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( in + x ) );
+                    const auto mask = ~static_cast<std::uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( val, zero ) ) );
+                    if ( mask )
+                    {
+                        bounds( x, mask );
+                        const auto lo = _mm256_cvtepu8_epi16( _mm256_castsi256_si128( val ) );
+                        const auto hi = _mm256_cvtepu8_epi16( _mm256_extracti128_si256( val, 1 ) );
+                        s32 = _mm256_add_epi32( s32, _mm256_add_epi32( _mm256_madd_epi16( lo, ones ), _mm256_madd_epi16( hi, ones ) ) );
+                        p32 = _mm256_add_epi32( p32, _mm256_add_epi32( _mm256_madd_epi16( lo, i_lo ), _mm256_madd_epi16( hi, i_hi ) ) );
+                        q32 = _mm256_add_epi32( q32, _mm256_add_epi32( _mm256_madd_epi16( lo, i2_lo ), _mm256_madd_epi16( hi, i2_hi ) ) );
+                    }
+                    u32 = _mm256_add_epi32( u32, s32 );
+                    w32 = _mm256_add_epi32( w32, u32 );
+                    v32 = _mm256_add_epi32( v32, p32 );
+                }
+                fold( c, n, 32, reduce( s32 ), reduce( p32 ), reduce( q32 ), reduce( u32 ), reduce( v32 ), reduce( w32 ) );
+            }
+        }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        {
+            // 16 pixels blocks, at most 64 by chunk
+            const auto zero = _mm_setzero_si128();
+            const auto ones = _mm_set1_epi16( 1 );
+            const auto i_lo = _mm_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7 );
+            const auto i_hi = _mm_setr_epi16( 8, 9, 10, 11, 12, 13, 14, 15 );
+            const auto i2_lo = _mm_setr_epi16( 0, 1, 4, 9, 16, 25, 36, 49 );
+            const auto i2_hi = _mm_setr_epi16( 64, 81, 100, 121, 144, 169, 196, 225 );
+            auto reduce = []( __m128i sums )
+                {
+                    alignas(16) std::int32_t lanes[4];
+                    _mm_store_si128( reinterpret_cast<__m128i*>( lanes ), sums );
+                    return std::accumulate( lanes, lanes + 4, std::int64_t(0) );
+                };
+
+            while ( x + 16 <= width )
+            {
+                const auto c = x;
+                const auto n = std::min( ( width - x ) / 16, std::size_t(64) );
+                auto s16 = zero, p16 = zero, q16 = zero, u16 = zero, v16 = zero, w16 = zero;
+                for ( std::size_t b = 0; b < n; ++b, x += 16 )
+                {
+                    const auto val = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + x ) );
+                    const auto mask = ~static_cast<std::uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( val, zero ) ) ) & 0xFFFFu;
+                    if ( mask )
+                    {
+                        bounds( x, mask );
+                        const auto lo = _mm_unpacklo_epi8( val, zero );
+                        const auto hi = _mm_unpackhi_epi8( val, zero );
+                        s16 = _mm_add_epi32( s16, _mm_add_epi32( _mm_madd_epi16( lo, ones ), _mm_madd_epi16( hi, ones ) ) );
+                        p16 = _mm_add_epi32( p16, _mm_add_epi32( _mm_madd_epi16( lo, i_lo ), _mm_madd_epi16( hi, i_hi ) ) );
+                        q16 = _mm_add_epi32( q16, _mm_add_epi32( _mm_madd_epi16( lo, i2_lo ), _mm_madd_epi16( hi, i2_hi ) ) );
+                    }
+                    u16 = _mm_add_epi32( u16, s16 );
+                    w16 = _mm_add_epi32( w16, u16 );
+                    v16 = _mm_add_epi32( v16, p16 );
+                }
+                fold( c, n, 16, reduce( s16 ), reduce( p16 ), reduce( q16 ), reduce( u16 ), reduce( v16 ), reduce( w16 ) );
+            }
+        }
+#endif
+        for ( ; x < width; ++x )
+        {
+            const auto val = static_cast<std::int64_t>( in[x] );
+            const auto fx = static_cast<std::int64_t>( x );
+            s += val;
+            sx += fx * val;
+            sxx += fx * fx * val;
+            first = ( val != 0 && first == width ) ? x : first;
+            last = val != 0 ? x : last;
+        }
+
+        return { static_cast<double>( s ), static_cast<double>( sx ), static_cast<double>( sxx ), first, last };
+    }
+
+    // computes the [1...width-2] interior pixels of a sobel output line
+    static void _sobel_line( const T* prev, const T* cur, const T* next, T* out, std::size_t width )
+    {
+        std::size_t x = 1UL;
+
+#if defined(TINYMAGE_USE_AVX2)
+        for ( ; x + 16 < width; x += 16 )
+        {
+            auto load = []( const T* p ) {
+                return _mm256_cvtepu8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) ) );
+            };
+            auto mag = _sobel_magnitude( load( prev + x - 1 ), load( prev + x ), load( prev + x + 1 ),
+                                         load( cur + x - 1 ), load( cur + x + 1 ),
+                                         load( next + x - 1 ), load( next + x ), load( next + x + 1 ) );
+            // saturate to [0,255], packus works in-lane so gather the two lower quadwords
+            mag = _mm256_permute4x64_epi64( _mm256_packus_epi16( mag, mag ), 0x08 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + x ), _mm256_castsi256_si128( mag ) );
+        }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        for ( ; x + 16 < width; x += 16 )
+        {
+            const auto zero = _mm_setzero_si128();
+            __m128i in[3][3];
+            const T* lines[3] = { prev, cur, next };
+            for ( auto j = 0; j < 3; j++ )
+                for ( auto i = 0; i < 3; i++ )
+                    in[j][i] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( lines[j] + x + i - 1 ) );
+
+            auto mag_lo = _sobel_magnitude(
+                _mm_unpacklo_epi8( in[0][0], zero ), _mm_unpacklo_epi8( in[0][1], zero ), _mm_unpacklo_epi8( in[0][2], zero ),
+                _mm_unpacklo_epi8( in[1][0], zero ), _mm_unpacklo_epi8( in[1][2], zero ),
+                _mm_unpacklo_epi8( in[2][0], zero ), _mm_unpacklo_epi8( in[2][1], zero ), _mm_unpacklo_epi8( in[2][2], zero ) );
+            auto mag_hi = _sobel_magnitude(
+                _mm_unpackhi_epi8( in[0][0], zero ), _mm_unpackhi_epi8( in[0][1], zero ), _mm_unpackhi_epi8( in[0][2], zero ),
+                _mm_unpackhi_epi8( in[1][0], zero ), _mm_unpackhi_epi8( in[1][2], zero ),
+                _mm_unpackhi_epi8( in[2][0], zero ), _mm_unpackhi_epi8( in[2][1], zero ), _mm_unpackhi_epi8( in[2][2], zero ) );
+
+            // saturate to [0,255]
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + x ), _mm_packus_epi16( mag_lo, mag_hi ) );
+        }
+#endif
+        for ( ; x < width - 1; ++x )
+        {
+            int gx = ( next[x-1] + 2*next[x] + next[x+1] ) - ( prev[x-1] + 2*prev[x] + prev[x+1] );
+            int gy = ( prev[x+1] - prev[x-1] ) + 2*( cur[x+1] - cur[x-1] ) + ( next[x+1] - next[x-1] );
+            out[x] = static_cast<T>( std::min( static_cast<int>( std::sqrt( static_cast<float>( gx*gx + gy*gy ) ) ), 255 ) );
+        }
+    }
+
+#if defined(TINYMAGE_USE_AVX2)
+    // sobel magnitude of 16 pixels from their widened 16 bits neighbourhood (center pixel is not used)
+    static __m256i _sobel_magnitude( __m256i tl, __m256i tc, __m256i tr, __m256i ml, __m256i mr, __m256i bl, __m256i bc, __m256i br )
+    {
+        // separable kernels : vertical derivative smoothed horizontally, horizontal derivative smoothed vertically
+        auto gx = _mm256_sub_epi16( _mm256_add_epi16( _mm256_add_epi16( bl, br ), _mm256_slli_epi16( bc, 1 ) ),
+                                    _mm256_add_epi16( _mm256_add_epi16( tl, tr ), _mm256_slli_epi16( tc, 1 ) ) );
+        auto gy = _mm256_add_epi16( _mm256_add_epi16( _mm256_sub_epi16( tr, tl ), _mm256_sub_epi16( br, bl ) ),
+                                    _mm256_slli_epi16( _mm256_sub_epi16( mr, ml ), 1 ) );
+
+        // gx*gx+gy*gy on 32 bits integers, then truncated float square root
+        auto lo = _mm256_unpacklo_epi16( gx, gy );
+        auto hi = _mm256_unpackhi_epi16( gx, gy );
+        lo = _mm256_cvttps_epi32( _mm256_sqrt_ps( _mm256_cvtepi32_ps( _mm256_madd_epi16( lo, lo ) ) ) );
+        hi = _mm256_cvttps_epi32( _mm256_sqrt_ps( _mm256_cvtepi32_ps( _mm256_madd_epi16( hi, hi ) ) ) );
+
+        // unpack and pack are both in-lane, so pixels order is restored
+        return _mm256_packs_epi32( lo, hi );
+    }
+#endif
+
+#if defined(TINYMAGE_USE_SSE)
+    // sobel magnitude of 8 pixels from their widened 16 bits neighbourhood (center pixel is not used)
+    static __m128i _sobel_magnitude( __m128i tl, __m128i tc, __m128i tr, __m128i ml, __m128i mr, __m128i bl, __m128i bc, __m128i br )
+    {
+        // separable kernels : vertical derivative smoothed horizontally, horizontal derivative smoothed vertically
+        auto gx = _mm_sub_epi16( _mm_add_epi16( _mm_add_epi16( bl, br ), _mm_slli_epi16( bc, 1 ) ),
+                                 _mm_add_epi16( _mm_add_epi16( tl, tr ), _mm_slli_epi16( tc, 1 ) ) );
+        auto gy = _mm_add_epi16( _mm_add_epi16( _mm_sub_epi16( tr, tl ), _mm_sub_epi16( br, bl ) ),
+                                 _mm_slli_epi16( _mm_sub_epi16( mr, ml ), 1 ) );
+
+        // gx*gx+gy*gy on 32 bits integers, then truncated float square root
+        auto lo = _mm_unpacklo_epi16( gx, gy );
+        auto hi = _mm_unpackhi_epi16( gx, gy );
+        lo = _mm_cvttps_epi32( _mm_sqrt_ps( _mm_cvtepi32_ps( _mm_madd_epi16( lo, lo ) ) ) );
+        hi = _mm_cvttps_epi32( _mm_sqrt_ps( _mm_cvtepi32_ps( _mm_madd_epi16( hi, hi ) ) ) );
+
+        return _mm_packs_epi32( lo, hi );
+    }
+#endif
+
+    // index of position i (possibly outside of [0,n[) under the border policy, n standing for a zero pixel
+    static std::size_t _border_index( std::ptrdiff_t i, std::size_t n, tinymage_types::border_policy border )
+    {
+        const auto last = static_cast<std::ptrdiff_t>( n ) - 1;
+        if ( i >= 0 && i <= last )
+            return static_cast<std::size_t>( i );
+
+        switch ( border )
+        {
+        case tinymage_types::border_policy::clamp:
+            return i < 0 ? 0 : static_cast<std::size_t>( last );
+        case tinymage_types::border_policy::mirror:
+        {
+            // reflections repeat every 2*last pixels, for kernels wider than the image
+            if ( last == 0 )
+                return 0;
+            const auto period = 2*last;
+            const auto j = std::abs( i ) % period;
+            return static_cast<std::size_t>( j > last ? period - j : j );
+        }
+        default:
+            return n;
+        }
+    }
+
+    // fills the r pixels on each side of the padded[r...r+width[ line, following the border policy
+    static void _pad_borders( float* padded, std::size_t width, std::size_t r, tinymage_types::border_policy border )
+    {
+        const float* in = padded + r;
+        for ( std::size_t i = 1; i <= r; ++i )
+        {
+            const auto left = _border_index( -static_cast<std::ptrdiff_t>( i ), width, border );
+            const auto right = _border_index( static_cast<std::ptrdiff_t>( width - 1 + i ), width, border );
+            padded[r - i] = left == width ? 0.f : in[left];
+            padded[r + width - 1 + i] = right == width ? 0.f : in[right];
+        }
+    }
+
+    // out[x] = sum of kernel[i] * taps[i][x]
+    template<std::size_t N>
+    static void _convolve_taps( const std::array<const float*,N>& taps, const std::array<float,N>& kernel, float* out, std::size_t width )
+    {
+        std::size_t x = 0;
+#if defined(TINYMAGE_USE_AVX2)
+        for ( ; x + 8 <= width; x += 8 )
+        {
+            auto sum = _mm256_mul_ps( _mm256_set1_ps( kernel[0] ), _mm256_loadu_ps( taps[0] + x ) );
+            for ( std::size_t i = 1; i < N; ++i )
+                sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_set1_ps( kernel[i] ), _mm256_loadu_ps( taps[i] + x ) ) );
+            _mm256_storeu_ps( out + x, sum );
+        }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        for ( ; x + 4 <= width; x += 4 )
+        {
+            auto sum = _mm_mul_ps( _mm_set1_ps( kernel[0] ), _mm_loadu_ps( taps[0] + x ) );
+            for ( std::size_t i = 1; i < N; ++i )
+                sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( kernel[i] ), _mm_loadu_ps( taps[i] + x ) ) );
+            _mm_storeu_ps( out + x, sum );
+        }
+#endif
+        for ( ; x < width; ++x )
+        {
+            auto sum = kernel[0] * taps[0][x];
+            for ( std::size_t i = 1; i < N; ++i )
+                sum += kernel[i] * taps[i][x];
+            out[x] = sum;
+        }
+    }
+
+    // float results to pixels, integer pixels being rounded to nearest and saturated
+    static void _store_line( const float* in, T* out, std::size_t width )
+    {
+        _store_line( in, out, width, std::is_integral<T>{} );
+    }
+
+    static void _store_line( const float* in, T* out, std::size_t width, std::false_type )
+    {
+        std::transform( in, in + width, out, []( float val ) { return static_cast<T>( val ); } );
+    }
+
+    static void _store_line( const float* in, T* out, std::size_t width, std::true_type )
+    {
+        const auto lo = static_cast<float>( std::numeric_limits<T>::lowest() );
+        const auto hi = static_cast<float>( std::numeric_limits<T>::max() );
+        // half away from zero rounding, which vectorizes unlike std::nearbyint
+        std::transform( in, in + width, out, [lo,hi]( float val )
+            {
+                val = std::min( std::max( val, lo ), hi );
+                return static_cast<T>( val < 0.f ? val - 0.5f : val + 0.5f );
+            });
+    }
+
+    std::pair<T,T> _minmax() const
+    {
+        auto min = c_at( 0, 0 );
+        auto max = c_at( 0, 0 );
+        tinymage_forY( (*this), y )
+        {
+            auto mm = std::minmax_element( line( y ), line( y ) + m_width );
+            min = std::min( min, *mm.first );
+            max = std::max( max, *mm.second );
+        }
+        return std::make_pair( min, max );
+    }
+
+    template<std::size_t nb_bins>
+    std::array<std::size_t,nb_bins> _get_histogram( std::false_type, std::size_t nb_threads ) const
+    {
+        T min, max;
+        std::tie( min, max ) = _minmax();
+
+        float inv_dynamic = nb_bins / static_cast<float>( max - min );
+        return _accumulate_histogram<nb_bins>( [=]( const T& val )
+            {
+                return val == max ? nb_bins-1 : static_cast<std::size_t>( (val-min) * inv_dynamic );
+            }, nb_threads );
+    }
+
+    template<std::size_t nb_bins>
+    std::array<std::size_t,nb_bins> _get_histogram( std::true_type, std::size_t nb_threads ) const
+    {
+        // raw 8 bits counts, the image dynamic is then read from the first and last non empty values
+        auto raw = _accumulate_histogram<256>( []( const T& val ) { return static_cast<std::size_t>( val ); }, nb_threads );
+
+        int min = 0;
+        while ( min < 255 && raw[min] == 0 ) min++;
+        int max = 255;
+        while ( max > min && raw[max] == 0 ) max--;
+
+        // merge raw counts with the same binning as the generic path
+        float inv_dynamic = nb_bins / static_cast<float>( max - min );
+        std::array<std::size_t,nb_bins> hist{}; // zero init
+        for ( auto val = min; val <= max; ++val )
+            hist[ val == max ? nb_bins-1 : static_cast<std::size_t>( (val-min) * inv_dynamic ) ] += raw[val];
+
+        return hist;
+    }
+
+    // counts bin( val ) over the whole image
+    // -> 4 interleaved sub-histograms avoid store-to-load stalls on runs of equal values
+    template<std::size_t nb_bins, typename Bin>
+    std::array<std::size_t,nb_bins> _accumulate_histogram( Bin bin, std::size_t nb_threads ) const
+    {
+        std::array<std::size_t,nb_bins> hist{}; // zero init
+        std::mutex hist_mutex;
+
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                std::array<std::array<std::size_t,nb_bins>,4> sub_hists{}; // zero init
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const T* in = line( y );
+                    std::size_t x = 0;
+                    for ( ; x + 4 <= m_width; x += 4 )
+                    {
+                        ++sub_hists[0][ bin( in[x] ) ];
+                        ++sub_hists[1][ bin( in[x+1] ) ];
+                        ++sub_hists[2][ bin( in[x+2] ) ];
+                        ++sub_hists[3][ bin( in[x+3] ) ];
+                    }
+                    for ( ; x < m_width; ++x )
+                        ++sub_hists[0][ bin( in[x] ) ];
+                }
+
+                std::lock_guard<std::mutex> lock( hist_mutex );
+                for ( std::size_t i = 0; i < nb_bins; ++i )
+                    hist[i] += sub_hists[0][i] + sub_hists[1][i] + sub_hists[2][i] + sub_hists[3][i];
+            });
+
+        return hist;
+    }
+
+    int _auto_threshold_value( tinymage_types::threshold_method method, std::size_t nb_threads = 1 ) const
+    {
+        return _threshold_value<256>( get_histogram<256>( nb_threads ), method );
+    }
+
+    template<std::size_t length>
+    static int _threshold_value( const std::array<std::size_t,length>& data, tinymage_types::threshold_method method )
+    {
+        // One of the many autothreshold IJ implementations:
+        // https://imagej.nih.gov/ij/developer/source/ij/process/AutoThresholder.java.html
+        switch ( method )
+        {
+        case tinymage_types::threshold_method::otsu:
+            return _otsu<length>( data );
+        case tinymage_types::threshold_method::isodata:
+        default:
+            return _default_isodata<length>( data );
+        }
+    }
+
+    template<std::size_t length>
+    static int _default_isodata( const std::array<std::size_t,length>& data )
+    {
+        std::array<std::size_t,length> data2;
+        std::size_t mode=0, maxCount=0, maxCount2=0;
+        for ( auto i=std::size_t(0); i<length; i++ ) {
+            data2[i] = data[i];
+            if ( data2[i]>maxCount ) {
+                maxCount = data2[i];
+                mode = i;
+            }
+        }
+        for ( auto i=std::size_t(0); i<length; i++ ) {
+            if ((data2[i]>maxCount2) && (i!=mode))
+                maxCount2 = data2[i];
+        }
+        auto hmax = maxCount;
+        if ( (hmax>(maxCount2*2)) && (maxCount2!=0) ) {
+            hmax = static_cast<int>( maxCount2 * 1.5 );
+            data2[mode] = hmax;
+        }
+        return _isodata<length>( data2 );
+    }
+
+    // Warning : will modify data array
+    template<std::size_t length>
+    static int _isodata( std::array<std::size_t,length>& data )
+    {
+        data.front() = 0; //set to zero so erased areas aren't included
+        data.back() = 0;
+
+        auto maxValue = length - 1;
+
+        auto min = std::size_t{0};
+        while ( (data[min]==0) && (min<maxValue) ) min++;
+        auto max = maxValue;
+        while ( (data[max]==0) && (max>0) ) max--;
+        if ( min>=max )
+            return static_cast<int>( length / 2 );
+
+        // prefix sums of counts and moments make each iteration O(1)
+        // -> integer sums are exact, results match the two halves being summed again on every iteration
+        std::array<std::size_t,length> counts{}, moments{};
+        std::size_t count = 0, moment = 0;
+        for ( auto i=min; i<=max; i++ ) {
+            count += data[i];
+            moment += i*data[i];
+            counts[i] = count;
+            moments[i] = moment;
+        }
+
+        double result, sum1, sum2, sum3, sum4;
+
+        auto movingIndex = min;
+        do {
+            sum1 = static_cast<double>( moments[movingIndex] );
+            sum2 = static_cast<double>( counts[movingIndex] );
+            sum3 = static_cast<double>( moments[max] - moments[movingIndex] );
+            sum4 = static_cast<double>( counts[max] - counts[movingIndex] );
+            result = (sum1/sum2 + sum3/sum4)/2.0;
+            movingIndex++;
+        } while ( ( movingIndex + 1 ) <= result && movingIndex < max - 1 );
+
+        return static_cast<int>( std::round( result ) );
+    }
+
+    // Otsu's method, maximizes the between class variance in a single pass over the bins
+    // -> empty bins between the two classes give a plateau of maximal variance, its center is returned
+    template<std::size_t length>
+    static int _otsu( const std::array<std::size_t,length>& data )
+    {
+        double total = 0., total_moment = 0.;
+        for ( auto i=std::size_t(0); i<length; i++ ) {
+            total += data[i];
+            total_moment += static_cast<double>( i*data[i] );
+        }
+
+        double back_count = 0., back_moment = 0., max_variance = 0.;
+        auto first = std::size_t(0), last = std::size_t(0);
+        for ( auto i=std::size_t(0); i<length; i++ ) {
+            back_count += data[i];
+            if ( back_count == 0. )
+                continue;
+            auto fore_count = total - back_count;
+            if ( fore_count == 0. )
+                break;
+            back_moment += static_cast<double>( i*data[i] );
+
+            auto mean_diff = back_moment / back_count - ( total_moment - back_moment ) / fore_count;
+            auto variance = back_count * fore_count * mean_diff * mean_diff;
+            if ( variance > max_variance ) {
+                max_variance = variance;
+                first = last = i;
+            }
+            else if ( variance == max_variance ) {
+                last = i;
+            }
+        }
+
+        return static_cast<int>( ( first + last ) / 2 );
+    }
+
+    template<bool projective>
+    void _transform_line( const tinymage_types::transform_t& tr, std::size_t y, T* out, std::size_t out_width ) const
+    {
+        // line constant terms of the numerators and denominator
+        const auto dy = static_cast<float>( y ) - tr.oy;
+        const auto x0 = tr.b * dy;
+        const auto y0 = tr.e * dy;
+        const auto w0 = tr.h * dy;
+
+        auto x = _transform_line_simd<projective>( std::is_same<T,float>{}, tr, x0, y0, w0, out, out_width );
+
+        for ( ; x < out_width; ++x )
+        {
+            const auto dx = static_cast<float>( x ) - tr.ox;
+            auto horizontal_position = ( tr.a * dx + x0 ) + tr.c;
+            auto vertical_position = ( tr.d * dx + y0 ) + tr.f;
+            if ( projective )
+            {
+                const auto w = ( tr.g * dx + w0 ) + 1.f;
+                horizontal_position /= w;
+                vertical_position /= w;
+            }
+            _bilinear_interpolation( out[x], horizontal_position, vertical_position );
+        }
+    }
+
+    // returns the number of output pixels processed
+    // -> float images only, and only under AVX2 as the bilinear fetch needs gathers : SSE builds use the scalar loop
+    template<bool projective>
+    std::size_t _transform_line_simd(   std::false_type, const tinymage_types::transform_t&, float, float, float,
+                                        T*, std::size_t ) const
+    {
+        return 0;
+    }
+
+    template<bool projective>
+    std::size_t _transform_line_simd(   std::true_type, const tinymage_types::transform_t& tr, float x0, float y0, float w0,
+                                        T* out, std::size_t out_width ) const
+    {
+        std::size_t x = 0;
+#if defined(TINYMAGE_USE_AVX2)
+        const auto lanes = _mm256_setr_ps( 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f );
+        const auto zero = _mm256_setzero_ps();
+        const auto origin = _mm256_set1_ps( tr.ox );
+        const auto max_x = _mm256_set1_ps( static_cast<float>( m_width ) - 1.f );
+        const auto max_y = _mm256_set1_ps( static_cast<float>( m_height ) - 1.f );
+        const auto one = _mm256_set1_epi32( 1 );
+        const auto stride = _mm256_set1_epi32( static_cast<int>( m_stride ) );
+
+        for ( ; x + 8 <= out_width; x += 8 )
+        {
+            const auto dx = _mm256_sub_ps( _mm256_add_ps( _mm256_set1_ps( static_cast<float>( x ) ), lanes ), origin );
+            auto horizontal_position = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( tr.a ), dx ), _mm256_set1_ps( x0 ) ), _mm256_set1_ps( tr.c ) );
+            auto vertical_position = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( tr.d ), dx ), _mm256_set1_ps( y0 ) ), _mm256_set1_ps( tr.f ) );
+            if ( projective )
+            {
+                const auto w = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( tr.g ), dx ), _mm256_set1_ps( w0 ) ), _mm256_set1_ps( 1.f ) );
+                horizontal_position = _mm256_div_ps( horizontal_position, w );
+                vertical_position = _mm256_div_ps( vertical_position, w );
+            }
+
+            // the four source pixels must lie inside the image, otherwise the output pixel is left untouched
+            const auto valid = _mm256_and_ps(
+                _mm256_and_ps( _mm256_cmp_ps( horizontal_position, zero, _CMP_GE_OQ ), _mm256_cmp_ps( horizontal_position, max_x, _CMP_LT_OQ ) ),
+                _mm256_and_ps( _mm256_cmp_ps( vertical_position, zero, _CMP_GE_OQ ), _mm256_cmp_ps( vertical_position, max_y, _CMP_LT_OQ ) ) );
+            if ( _mm256_movemask_ps( valid ) == 0 )
+                continue;
+
+            const auto left = _mm256_floor_ps( horizontal_position );
+            const auto top = _mm256_floor_ps( vertical_position );
+            const auto horizontal_progress = _mm256_sub_ps( horizontal_position, left );
+            const auto vertical_progress = _mm256_sub_ps( vertical_position, top );
+
+            // masked gathers never touch the invalid lanes
+            const auto tl = _mm256_add_epi32( _mm256_mullo_epi32( _mm256_cvttps_epi32( top ), stride ), _mm256_cvttps_epi32( left ) );
+            const auto bl = _mm256_add_epi32( tl, stride );
+            const auto top_left = _mm256_mask_i32gather_ps( zero, m_data, tl, valid, 4 );
+            const auto top_right = _mm256_mask_i32gather_ps( zero, m_data, _mm256_add_epi32( tl, one ), valid, 4 );
+            const auto bottom_left = _mm256_mask_i32gather_ps( zero, m_data, bl, valid, 4 );
+            const auto bottom_right = _mm256_mask_i32gather_ps( zero, m_data, _mm256_add_epi32( bl, one ), valid, 4 );
+
+            const auto top_block = _mm256_add_ps( top_left, _mm256_mul_ps( horizontal_progress, _mm256_sub_ps( top_right, top_left ) ) );
+            const auto bottom_block = _mm256_add_ps( bottom_left, _mm256_mul_ps( horizontal_progress, _mm256_sub_ps( bottom_right, bottom_left ) ) );
+            const auto result = _mm256_add_ps( top_block, _mm256_mul_ps( vertical_progress, _mm256_sub_ps( bottom_block, top_block ) ) );
+
+            _mm256_storeu_ps( out + x, _mm256_blendv_ps( _mm256_loadu_ps( out + x ), result, valid ) );
+        }
+#else
+        (void)tr; (void)x0; (void)y0; (void)w0; (void)out; (void)out_width;
+#endif
+        return x;
+    }
+
+    void _bilinear_interpolation( T& out, float horizontal_position, float vertical_position ) const
+    {
+        // check if any of the four source pixels is outside of the image. If so,
+        // skip interpolating this pixel. (also rejects NaN positions)
+        if ( !( horizontal_position >= 0.f && horizontal_position < static_cast<float>( m_width ) - 1.f &&
+                vertical_position >= 0.f && vertical_position < static_cast<float>( m_height ) - 1.f ) )
+            return;
+
+        // positions are positive, truncation is a floor
+        auto left = static_cast<std::size_t>( horizontal_position );
+        auto top = static_cast<std::size_t>( vertical_position );
+
+        // figure out "how far" the output pixel being considered is between *_left and *_right.
+        auto horizontal_progress = horizontal_position - left;
+        auto vertical_progress = vertical_position - top;
+
+        const T* top_left = line( top ) + left;
+        const T* bottom_left = top_left + m_stride;
+
+        // combine top_left and top_right into one large, horizontal block.
+        auto top_block = top_left[0] + horizontal_progress * ( top_left[1] - top_left[0] );
+
+        // combine bottom_left and bottom_right into one large, horizontal block.
+        auto bottom_block = bottom_left[0] + horizontal_progress * ( bottom_left[1] - bottom_left[0] );
+
+        // combine the top_block and bottom_block using vertical interpolation and return as the resulting pixel.
+        out = static_cast<T>( top_block + vertical_progress * ( bottom_block - top_block ) );
+    }
+};
+
+// lazy point-wise expression over a tinymage view
+// -> threshold/normalize/convert/apply/scalar substraction are composed into a single pixel functor,
+//    no intermediate image is ever allocated
+// -> pixels are only computed when the expression is reduced (minmax, histogram, sums...)
+//    or evaluated into a destination image, each in a single pass
+template<typename T, typename F>
+class tinymage_expr final
+{
+    // any other type of expression is a friend.
+    template <typename U, typename G>
+    friend class tinymage_expr;
+    // binary images are packed straight from the expression pixels
+    friend class tinymage_binary;
+    friend class tinymage_rle;
+
+public:
+
+    using value_type = std::decay_t<decltype( std::declval<F>()( std::declval<T>() ) )>;
+
+    tinymage_expr( const tinymage_view<T>& src, F func )
+        : m_src{src}, m_func{func}, m_has_range{false}, m_range{} {}
+
+    std::size_t width() const { return m_src.width(); }
+    std::size_t height() const { return m_src.height(); }
+    std::size_t size() const { return m_src.size(); }
+
+    value_type operator()( std::size_t x, std::size_t y ) const
+    {
+        return m_func( m_src.c_at( x, y ) );
+    }
+
+    // g is applied to the value of each pixel
+    template<typename G>
+    auto apply( G g ) const
+    {
+        auto f = m_func;
+        auto func = [f,g]( const T& val ) { return g( f( val ) ); };
+        return tinymage_expr<T,decltype(func)>( m_src, func );
+    }
+
+    template<typename R>
+    auto convert() const
+    {
+        return apply( []( const value_type& val ) { return static_cast<R>( val ); } );
+    }
+
+    auto threshold( value_type thresh ) const
+    {
+        return apply( [thresh]( const value_type& val ) { return val > thresh ? value_type{1} : value_type{0}; } );
+    }
+
+    // needs one reduction pass, unless the range of the expression is already known
+    // -> the reduction may run concurrently on nb_threads threads
+    auto normalize( value_type min, value_type max, std::size_t nb_threads = 1 ) const
+    {
+        assert( max > min );
+
+        value_type cur_min, cur_max;
+        std::tie( cur_min, cur_max ) = minmax( nb_threads );
+
+        assert( cur_max > cur_min );
+
+        double cur_dyn = cur_max - cur_min;
+        double out_dyn = max - min;
+
+        auto norm = [min,out_dyn,cur_min,cur_dyn]( const value_type& val )
+            {
+                return static_cast<value_type>( min + ( out_dyn * ( val - cur_min ) / cur_dyn ) );
+            };
+
+        // the mapping is monotonic, so the output range is known without any further pass
+        auto output = apply( norm );
+        output._set_range( norm( cur_min ), norm( cur_max ) );
+        return output;
+    }
+
+    // needs one reduction pass to compute the histogram
+    auto auto_threshold(    tinymage_types::threshold_method method = tinymage_types::threshold_method::isodata,
+                            std::size_t nb_threads = 1 ) const
+    {
+        return threshold( static_cast<value_type>(
+            tinymage_view<value_type>::template _threshold_value<256>( get_histogram<256>( nb_threads ), method ) ) );
+    }
+
+    std::pair<value_type,value_type> minmax( std::size_t nb_threads = 1 ) const
+    {
+        if ( m_has_range )
+            return m_range;
+
+        return _minmax( is_tabulated{}, nb_threads );
+    }
+
+    value_type mean( std::size_t nb_threads = 1 ) const
+    {
+        return static_cast<value_type>( _sum( is_tabulated{}, nb_threads ) / size() );
+    }
+
+    // lines bands are counted in separate histograms, merged at the end
+    template<std::size_t nb_bins>
+    std::array<std::size_t,nb_bins> get_histogram( std::size_t nb_threads = 1 ) const
+    {
+        value_type min, max;
+        std::tie( min, max ) = minmax( nb_threads );
+
+        float inv_dynamic = nb_bins / static_cast<float>( max - min );
+        auto bin = [=]( const value_type& val )
+            {
+                return val == max ? nb_bins-1 : static_cast<std::size_t>( (val-min) * inv_dynamic );
+            };
+
+        return _get_histogram<nb_bins>( is_tabulated{}, bin, nb_threads );
+    }
+
+    template<typename U = value_type>
+    std::enable_if_t<std::is_same<U, float>::value, std::pair<tinymage<U>,tinymage<U>>> line_row_sums() const
+    {
+        auto outputs = std::make_pair<tinymage<U>,tinymage<U>>(
+            tinymage<U>( 1, height(), 0.f ),
+            tinymage<U>( width(), 1, 0.f )
+        );
+
+        tinymage_forY( m_src, y )
+        {
+            const T* in = m_src.line( y );
+            tinymage_forX( m_src, x )
+            {
+                auto val = m_func( in[x] );
+                outputs.first[y] += val;
+                outputs.second[x] += val;
+            }
+        }
+
+        return outputs;
+    }
+
+    template<typename A = std::allocator<value_type>>
+    tinymage<value_type,A> eval( std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        tinymage<value_type,A> output( alloc );
+        eval_into( output, nb_threads );
+        return output;
+    }
+
+    // writes into an existing image, reshaped to the source size without allocation if its buffer is large enough
+    // NOTE : dst may be the source image itself
+    template<typename A>
+    void eval_into( tinymage<value_type,A>& dst, std::size_t nb_threads = 1 ) const
+    {
+        dst.reshape( width(), height() );
+        _eval_into( is_tabulated{}, dst, nb_threads );
+    }
+
+private:
+
+    // f( start, stop ) is called on lines bands, concurrently if nb_threads allows it
+    template<typename Func>
+    void _for_each_band( std::size_t nb_threads, Func f ) const
+    {
+        tinyutils::parallel_for( height(), m_src._nb_tasks( nb_threads ), f );
+    }
+
+    // f is called on each pixel value of the [start,stop[ lines
+    template<typename Func>
+    void _for_each( std::size_t start, std::size_t stop, Func f ) const
+    {
+        for ( auto y = start; y < stop; ++y )
+        {
+            const T* in = m_src.line( y );
+            tinymage_forX( m_src, x )
+                f( m_func( in[x] ) );
+        }
+    }
+
+    void _set_range( value_type min, value_type max )
+    {
+        m_has_range = true;
+        m_range = std::make_pair( min, max );
+    }
+
+    // 8 bits sources only take 256 values, so the pixel functor is tabulated once per evaluation
+    // -> reductions are computed from the raw source histogram, with the functor evaluated on present values only
+    // -> results are the same as per pixel evaluations, up to the summation order of mean
+    using is_tabulated = std::is_same<T,unsigned char>;
+
+    std::array<value_type,256> _table() const
+    {
+        std::array<value_type,256> table;
+        for ( std::size_t v = 0; v < table.size(); ++v )
+            table[v] = m_func( static_cast<T>( v ) );
+        return table;
+    }
+
+    std::array<std::size_t,256> _source_histogram( std::size_t nb_threads ) const
+    {
+        return m_src.template _accumulate_histogram<256>( []( const T& val ) { return static_cast<std::size_t>( val ); }, nb_threads );
+    }
+
+    std::pair<value_type,value_type> _minmax( std::false_type, std::size_t nb_threads ) const
+    {
+        const auto first = (*this)( 0, 0 );
+        auto min = first, max = first;
+        std::mutex minmax_mutex;
+        _for_each_band( nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                auto band_min = first, band_max = first;
+                _for_each( start, stop, [&]( const value_type& val )
+                    {
+                        band_min = std::min( band_min, val );
+                        band_max = std::max( band_max, val );
+                    });
+
+                std::lock_guard<std::mutex> lock( minmax_mutex );
+                min = std::min( min, band_min );
+                max = std::max( max, band_max );
+            });
+        return std::make_pair( min, max );
+    }
+
+    std::pair<value_type,value_type> _minmax( std::true_type, std::size_t nb_threads ) const
+    {
+        const auto counts = _source_histogram( nb_threads );
+
+        const auto first = (*this)( 0, 0 );
+        auto min = first, max = first;
+        for ( std::size_t v = 0; v < counts.size(); ++v )
+        {
+            if ( counts[v] == 0 )
+                continue;
+            const auto val = m_func( static_cast<T>( v ) );
+            min = std::min( min, val );
+            max = std::max( max, val );
+        }
+        return std::make_pair( min, max );
+    }
+
+    double _sum( std::false_type, std::size_t ) const
+    {
+        auto sum = 0.;
+        _for_each( 0, height(), [&]( const value_type& val ) { sum += val; } );
+        return sum;
+    }
+
+    double _sum( std::true_type, std::size_t nb_threads ) const
+    {
+        const auto counts = _source_histogram( nb_threads );
+
+        auto sum = 0.;
+        for ( std::size_t v = 0; v < counts.size(); ++v )
+            if ( counts[v] != 0 )
+                sum += static_cast<double>( m_func( static_cast<T>( v ) ) ) * counts[v];
+        return sum;
+    }
+
+    template<typename A>
+    void _eval_into( std::false_type, tinymage<value_type,A>& dst, std::size_t nb_threads ) const
+    {
+        _for_each_band( nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const T* in = m_src.line( y );
+                    value_type* out = dst.line( y );
+                    tinymage_forX( m_src, x )
+                        out[x] = m_func( in[x] );
+                }
+            });
+    }
+
+    template<typename A>
+    void _eval_into( std::true_type, tinymage<value_type,A>& dst, std::size_t nb_threads ) const
+    {
+        const auto table = _table();
+        _for_each_band( nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const T* in = m_src.line( y );
+                    value_type* out = dst.line( y );
+                    tinymage_forX( m_src, x )
+                        out[x] = table[ in[x] ];
+                }
+            });
+    }
+
+    template<std::size_t nb_bins, typename Bin>
+    std::array<std::size_t,nb_bins> _get_histogram( std::false_type, Bin bin, std::size_t nb_threads ) const
+    {
+        std::array<std::size_t,nb_bins> hist{}; // zero init
+        std::mutex hist_mutex;
+        _for_each_band( nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                std::array<std::size_t,nb_bins> band_hist{}; // zero init
+                _for_each( start, stop, [&]( const value_type& val ) { ++band_hist[ bin( val ) ]; } );
+
+                std::lock_guard<std::mutex> lock( hist_mutex );
+                for ( std::size_t i = 0; i < nb_bins; ++i )
+                    hist[i] += band_hist[i];
+            });
+
+        return hist;
+    }
+
+    template<std::size_t nb_bins, typename Bin>
+    std::array<std::size_t,nb_bins> _get_histogram( std::true_type, Bin bin, std::size_t nb_threads ) const
+    {
+        const auto counts = _source_histogram( nb_threads );
+
+        std::array<std::size_t,nb_bins> hist{}; // zero init
+        for ( std::size_t v = 0; v < counts.size(); ++v )
+            if ( counts[v] != 0 )
+                hist[ bin( m_func( static_cast<T>( v ) ) ) ] += counts[v];
+        return hist;
+    }
+
+private:
+
+    tinymage_view<T> m_src;
+    F m_func;
+
+    bool m_has_range;
+    std::pair<value_type,value_type> m_range;
+};
+
+template <typename T, typename F>
+inline auto operator-( const typename tinymage_expr<T,F>::value_type& val, const tinymage_expr<T,F>& e )
+{
+    using V = typename tinymage_expr<T,F>::value_type;
+    return e.apply( [val]( const V& eval ) { return static_cast<V>( val - eval ); } );
+}
+
+// read-only 8 bits grayscale pixels of an image file, exposed as a view without any copy
+// -> binary PGM (P5) and headerless raw files are memory mapped, the view pointing right into the mapping
+// -> other formats are decoded by stb, the view pointing into the decoder buffer
+class tinymage_file final
+{
+public:
+    tinymage_file() = default;
+    ~tinymage_file() { close(); }
+
+    tinymage_file( const tinymage_file& ) = delete;
+    tinymage_file& operator=( const tinymage_file& ) = delete;
+
+    bool open( const std::string& path )
+    {
+        close();
+
+        // PGM header is parsed in place, decoding is only needed for compressed formats
+        if ( _map( path ) )
+        {
+            std::size_t header = 0;
+            if ( _parse_pgm( header ) )
+            {
+                m_pixels = m_mapping + header;
+                m_channels = 1;
+                return true;
+            }
+            close();
+        }
+
+        int width, height, bpp;
+        m_decoded = stbi_load( path.c_str(), &width, &height, &bpp, 1 ); // force grayscale at image load
+        if ( m_decoded == nullptr )
+            return false;
+        m_pixels = m_decoded;
+        m_width = static_cast<std::size_t>( width );
+        m_height = static_cast<std::size_t>( height );
+        m_channels = static_cast<std::size_t>( bpp );
+        return true;
+    }
+
+    // headerless sx*sy 8 bits pixels, starting at offset bytes in the file
+    bool open_raw( const std::string& path, std::size_t sx, std::size_t sy, std::size_t offset = 0 )
+    {
+        close();
+
+        if ( !_map( path ) || m_mapping_size < offset + sx*sy )
+        {
+            close();
+            return false;
+        }
+        m_pixels = m_mapping + offset;
+        m_width = sx;
+        m_height = sy;
+        m_channels = 1;
+        return true;
+    }
+
+    void close()
+    {
+        if ( m_decoded )
+            stbi_image_free( m_decoded );
+#ifdef TINYMAGE_USE_MMAP
+        if ( m_mapping )
+            munmap( const_cast<unsigned char*>( m_mapping ), m_mapping_size );
+#else
+        m_buffer.clear();
+#endif
+        m_decoded = nullptr;
+        m_mapping = nullptr;
+        m_mapping_size = 0;
+        m_pixels = nullptr;
+        m_width = m_height = m_channels = 0;
+    }
+
+    bool is_open() const { return m_pixels != nullptr; }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+
+    // channels count stored in the file, pixels being always exposed as grayscale
+    std::size_t channels() const { return m_channels; }
+
+    const unsigned char* data() const { return m_pixels; }
+
+    tinymage_view<unsigned char> view() const
+    {
+        return tinymage_view<unsigned char>( m_pixels, m_width, m_height );
+    }
+
+    operator tinymage_view<unsigned char>() const
+    {
+        return view();
+    }
+
+private:
+
+    bool _map( const std::string& path )
+    {
+#ifdef TINYMAGE_USE_MMAP
+        const auto fd = ::open( path.c_str(), O_RDONLY );
+        if ( fd < 0 )
+            return false;
+
+        struct stat st;
+        void* mapping = MAP_FAILED;
+        if ( fstat( fd, &st ) == 0 && st.st_size > 0 )
+            mapping = mmap( nullptr, static_cast<std::size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+        ::close( fd ); // the mapping stays valid
+
+        if ( mapping == MAP_FAILED )
+            return false;
+        m_mapping = static_cast<const unsigned char*>( mapping );
+        m_mapping_size = static_cast<std::size_t>( st.st_size );
+#else
+        std::unique_ptr<FILE, int(*)(FILE*)> file( std::fopen( path.c_str(), "rb" ), &std::fclose );
+        if ( !file )
+            return false;
+        std::fseek( file.get(), 0, SEEK_END );
+        const auto size = std::ftell( file.get() );
+        std::fseek( file.get(), 0, SEEK_SET );
+        if ( size <= 0 )
+            return false;
+        m_buffer.resize( static_cast<std::size_t>( size ) );
+        if ( std::fread( m_buffer.data(), 1, m_buffer.size(), file.get() ) != m_buffer.size() )
+            return false;
+        m_mapping = m_buffer.data();
+        m_mapping_size = m_buffer.size();
+#endif
+        return true;
+    }
+
+    // reads the dimensions of an 8 bits binary PGM, header is set to the first pixel offset
+    bool _parse_pgm( std::size_t& header )
+    {
+        // the magic number is followed by a whitespace
+        if ( m_mapping_size < 3 || m_mapping[0] != 'P' || m_mapping[1] != '5' || !std::isspace( m_mapping[2] ) )
+            return false;
+
+        std::size_t pos = 2;
+        auto next_value = [&]( std::size_t& value, std::size_t max_value )
+            {
+                // whitespaces and comment lines before each header value
+                while ( pos < m_mapping_size && ( std::isspace( m_mapping[pos] ) || m_mapping[pos] == '#' ) )
+                {
+                    if ( m_mapping[pos] == '#' )
+                        while ( pos < m_mapping_size && m_mapping[pos] != '\n' ) ++pos;
+                    else
+                        ++pos;
+                }
+                if ( pos >= m_mapping_size || !std::isdigit( m_mapping[pos] ) )
+                    return false;
+                // the accumulation stops as soon as max_value is exceeded, before it can overflow
+                for ( value = 0; pos < m_mapping_size && std::isdigit( m_mapping[pos] ); ++pos )
+                {
+                    value = 10 * value + static_cast<std::size_t>( m_mapping[pos] - '0' );
+                    if ( value > max_value )
+                        return false;
+                }
+                return true;
+            };
+
+        std::size_t max_val = 0;
+        // neither dimension can exceed the mapping size
+        if ( !next_value( m_width, m_mapping_size ) || !next_value( m_height, m_mapping_size ) || !next_value( max_val, 255 ) || max_val == 0 )
+            return false;
+
+        // a single whitespace separates the header from the pixels
+        if ( pos >= m_mapping_size || !std::isspace( m_mapping[pos] ) )
+            return false;
+        header = pos + 1;
+
+        // width and height are bounded by the mapping size, the pixels count is still checked without multiplying
+        return m_width > 0 && m_height > 0 && m_width <= ( m_mapping_size - header ) / m_height;
+    }
+
+private:
+    unsigned char* m_decoded = nullptr;
+    const unsigned char* m_mapping = nullptr;
+    std::size_t m_mapping_size = 0;
+#ifndef TINYMAGE_USE_MMAP
+    std::vector<unsigned char> m_buffer;
+#endif
+    const unsigned char* m_pixels = nullptr;
+    std::size_t m_width = 0;
+    std::size_t m_height = 0;
+    std::size_t m_channels = 0;
+};
+
+// lightweight header only image class
+// -> pixels are stored through Alloc (see tinymage_arena for frame scoped temporaries)
+// -> copies, crops, conversions, resamplings and sobel results keep the image allocator,
+//    projections and derivatives always use the default one
+template<typename T, typename Alloc>
+class tinymage final : private std::vector<T,Alloc>
+{
+    // any other type of tinymage is a friend.
+    template <typename U, typename B>
+    friend class tinymage;
+
+    template<typename U,typename V>
+    using tinymage_if = std::enable_if_t<std::is_same<V, U>::value, tinymage<U>>;
+    template<typename U,typename V>
+    using tinymage_if_pair = std::enable_if_t<std::is_same<V, U>::value, std::pair<tinymage<U>,tinymage<U>>>;
+
+    template<typename U> using tinymage_if_uchar = tinymage_if<U,unsigned char>;
+    template<typename U> using tinymage_if_float = tinymage_if<U,float>;
+
+    template<typename U> using tinymage_if_pair_float = tinymage_if_pair<U,float>;
+
+    template<typename R> using rebind_alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<R>;
+
+    using std::vector<T,Alloc>::at;
+    using std::vector<T,Alloc>::assign;
+    using std::vector<T,Alloc>::size;
+
+    using std::vector<T,Alloc>::begin;
+    using std::vector<T,Alloc>::end;
+
+public:
+
+    using std::vector<T,Alloc>::data;
+    using std::vector<T,Alloc>::get_allocator;
+
+    tinymage() : m_width{0}, m_height{0}, m_stride{0} {}
+    explicit tinymage( const Alloc& alloc ) : std::vector<T,Alloc>( alloc ), m_width{0}, m_height{0}, m_stride{0} {}
+    tinymage( std::size_t sx, std::size_t sy, T val = 0, const Alloc& alloc = Alloc() )
+        : std::vector<T,Alloc>( _padded_stride( sx )*sy, val, alloc ), m_width{sx}, m_height{sy}, m_stride{_padded_stride( sx )} {}
+    tinymage( uint8_t* buf, std::size_t sx, std::size_t sy, std::size_t bpp ) : m_width{sx}, m_height{sy}, m_stride{_padded_stride( sx )}
+    {
+        assert( bpp == sizeof(T) );
+        _assign_lines( buf, sx );
+    }
+    // materializes the pixels of a view, converted if its pixel type differs
+    template<typename U>
+    explicit tinymage( const tinymage_view<U>& view, const Alloc& alloc = Alloc() )
+        : std::vector<T,Alloc>( alloc ), m_width{view.width()}, m_height{view.height()}, m_stride{_padded_stride( view.width() )}
+    {
+        _assign_lines( view.data(), view.stride() );
+    }
+
+    // number of pixels, padding excluded
+    std::size_t size() const { return m_width * m_height; }
+
+    // changes the dimensions, the buffer being reallocated only if its capacity is too small
+    // NOTE : pixels are left unspecified, this is meant for images about to be overwritten (see the view *_into operations)
+    void reshape( std::size_t sx, std::size_t sy )
+    {
+        m_width = sx;
+        m_height = sy;
+        m_stride = _padded_stride( sx );
+        std::vector<T,Alloc>::resize( m_stride*sy );
+    }
+
+    // distance in elements between two consecutive lines
+    // -> equals the width, unless the allocator requests aligned rows (see tinymage_aligned_allocator)
+    std::size_t stride() const { return m_stride; }
+
+    T* line( std::size_t y )
+    {
+        return data() + m_stride*y;
+    }
+
+    const T* line( std::size_t y ) const
+    {
+        return data() + m_stride*y;
+    }
+
+    // the pixels are copied once, straight from the file mapping for PGM files (see tinymage_file)
+    // -> files are always read as 8 bits grayscale, whatever their channels count, then converted to T
+    bool load( const std::string& img_path )
+    {
+        tinymage_file file;
+        if ( !file.open( img_path ) )
+            return false;
+        m_width = file.width();
+        m_height = file.height();
+        m_stride = _padded_stride( m_width );
+        _assign_lines( file.data(), m_width );
+        return true;
+    }
+
+    bool load_raw( const std::string& img_path, std::size_t sx, std::size_t sy, std::size_t offset = 0 )
+    {
+        tinymage_file file;
+        if ( !file.open_raw( img_path, sx, sy, offset ) )
+            return false;
+        m_width = sx;
+        m_height = sy;
+        m_stride = _padded_stride( m_width );
+        _assign_lines( file.data(), m_width );
+        return true;
+    }
+
+    // converts interleaved 8 bits pixels to luma ( 0.2126 R + 0.7152 G + 0.0722 B ), the image taking the output size
+    // -> src_stride is the distance in bytes between two source lines, 0 for packed lines
+    // -> scale 2 or 4 averages scale x scale source blocks in the same pass (trailing source pixels are dropped)
+    // -> output lines may be converted concurrently by nb_threads threads, the buffer is reused if the size does not change
+    void ingest(    const uint8_t* src, std::size_t sx, std::size_t sy, tinymage_types::pixel_format format,
+                    std::size_t src_stride = 0, std::size_t scale = 1, std::size_t nb_threads = 1 )
+    {
+        assert( scale == 1 || scale == 2 || scale == 4 );
+
+        const auto layout = _get_layout( format );
+        if ( src_stride == 0 )
+            src_stride = sx * layout.bpp;
+
+        const auto nsx = sx / scale;
+        const auto nsy = sy / scale;
+        reshape( nsx, nsy );
+
+        const auto inv_area = 1.f / static_cast<float>( scale * scale );
+        tinyutils::parallel_for( nsy, view()._nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                // float outputs at full scale are written in place, other cases go through a line accumulator
+                const bool direct = ( scale == 1 ) && std::is_same<T,float>::value;
+                std::vector<float> acc( direct ? 0 : nsx * scale );
+
+                for ( auto y = start; y < stop; ++y )
+                {
+                    if ( direct )
+                    {
+                        _luma_line<false>( src + src_stride*y, nsx, layout, reinterpret_cast<float*>( line( y ) ) );
+                        continue;
+                    }
+
+                    _luma_line<false>( src + src_stride*y*scale, acc.size(), layout, acc.data() );
+                    for ( std::size_t k = 1; k < scale; ++k )
+                        _luma_line<true>( src + src_stride*( y*scale + k ), acc.size(), layout, acc.data() );
+
+                    T* out = line( y );
+                    for ( std::size_t x = 0; x < nsx; ++x )
+                    {
+                        auto sum = 0.f;
+                        for ( std::size_t k = 0; k < scale; ++k )
+                            sum += acc[ x*scale + k ];
+                        out[x] = static_cast<T>( scale == 1 ? sum : sum * inv_area );
+                    }
+                }
+            });
+    }
+
+    // decodes files concurrently on nb_threads threads, one image per path
+    // -> images failing to load are left empty, the number of loaded images is returned
+    static std::size_t load_batch(  const std::vector<std::string>& img_paths, std::vector<tinymage>& images,
+                                    std::size_t nb_threads = tinymage_types::auto_threads )
+    {
+        images.resize( img_paths.size() );
+
+        std::vector<char> loaded( img_paths.size(), 0 );
+        tinyutils::parallel_for( img_paths.size(), nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto i = start; i < stop; ++i )
+                {
+                    loaded[i] = images[i].load( img_paths[i] );
+                    if ( !loaded[i] )
+                        images[i] = tinymage( images[i].get_allocator() );
+                }
+            });
+
+        return static_cast<std::size_t>( std::count( loaded.begin(), loaded.end(), 1 ) );
+    }
+
+    bool save_png( const std::string& img_path )
+    {
+        return stbi_write_png( img_path.c_str(), static_cast<int>( m_width ), static_cast<int>( m_height ), 1,
+			data(), static_cast<int>( m_stride * sizeof(T) ) ) != 0;
+    }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+
+    // non-owning view on the whole image
+    tinymage_view<T> view() const
+    {
+        return tinymage_view<T>( data(), m_width, m_height, m_stride );
+    }
+
+    operator tinymage_view<T>() const
+    {
+        return view();
+    }
+
+    // i-th pixel in lines order, padding excluded
+    T& operator[]( std::size_t i )
+    {
+        return m_stride == m_width ? at( i ) : at( i % m_width + m_stride*( i / m_width ) );
+    }
+
+    T& at( std::size_t x, std::size_t y )
+    {
+        return at( x + m_stride*y );
+    }
+
+    template<typename T2>
+    T2 at( std::size_t x, std::size_t y ) const
+    {
+        return static_cast<T2>( at( x + m_stride*y ) );
+    }
+
+    const T& c_at( std::size_t x, std::size_t y ) const
+    {
+        return at( x + m_stride*y );
+    }
+
+    template<typename Func>
+    void apply( Func f )
+    {
+        tinymage_forY( (*this), y )
+            std::for_each( line( y ), line( y ) + m_width, f );
+    }
+
+    template<typename R>
+    tinymage<R,rebind_alloc_t<R>> convert() const
+    {
+        tinymage<R,rebind_alloc_t<R>> output{ rebind_alloc_t<R>( get_allocator() ) };
+        output.m_width = m_width;
+        output.m_height = m_height;
+        output.m_stride = output._padded_stride( m_width );
+        output._assign_lines( data(), m_stride );
+        return output;
+    }
+
+    // root of a lazy point-wise expression on the image pixels
+    tinymage_expr<T,tinymage_types::identity_t> lazy() const
+    {
+        return view().lazy();
+    }
+
+    void normalize( T min, T max, std::size_t nb_threads = 1 )
+    {
+        lazy().normalize( min, max, nb_threads ).eval_into( *this, nb_threads );
+    }
+
+    tinymage get_normalize( T min, T max, std::size_t nb_threads = 1 ) const
+    {
+        return lazy().normalize( min, max, nb_threads ).eval( nb_threads, get_allocator() );
+    }
+
+    T mean() const
+    {
+        return view().mean();
+    }
+
+    float line_centroid( size_t index ) const
+    {
+        return view().line_centroid( index );
+    }
+
+    tinymage_types::moments_t get_moments( std::size_t nb_threads = 1 ) const
+    {
+        return view().get_moments( nb_threads );
+    }
+
+    // lines may be thresholded concurrently by nb_threads threads
+    void threshold( T thresh, std::size_t nb_threads = 1 )
+    {
+        tinyutils::parallel_for( m_height, view()._nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                    std::for_each( line( y ), line( y ) + m_width, [&]( T& val )
+                        {
+                            val = val > thresh ? m_one : m_zero;
+                        });
+            });
+    }
+
+    tinymage_view<T> get_crop_view(    std::size_t startx,
+                                        std::size_t starty,
+                                        std::size_t stopx,
+                                        std::size_t stopy ) const
+    {
+        return view().get_crop_view( startx, starty, stopx, stopy );
+    }
+
+    tinymage get_crop(  std::size_t startx,
+                        std::size_t starty,
+                        std::size_t stopx,
+                        std::size_t stopy ) const
+    {
+        return get_crop_view( startx, starty, stopx, stopy ).materialize( get_allocator() );
+    }
+
+    // in place, lines are moved towards the start of the buffer which keeps its capacity
+    void crop(  std::size_t startx,
+                std::size_t starty,
+                std::size_t stopx,
+                std::size_t stopy )
+    {
+        assert( startx <= stopx && stopx <= m_width );
+        assert( starty <= stopy && stopy <= m_height );
+
+        const auto nsx = stopx - startx;
+        const auto nstride = _padded_stride( nsx );
+        for ( std::size_t y = 0; y < stopy - starty; ++y )
+        {
+            const T* in = line( starty + y ) + startx;
+            T* out = data() + nstride*y;
+            if ( in != out )
+                std::copy( in, in + nsx, out );
+        }
+        reshape( nsx, stopy - starty );
+    }
+
+    void remove_border( std::size_t px_size )
+    {
+        crop( px_size, px_size, m_width - px_size, m_height - px_size );
+    }
+
+    // in place
+    void shift( int sx, int sy, T pad_val = 0 )
+    {
+        view().shift_into( *this, sx, sy, pad_val );
+    }
+
+    tinymage get_shift( int sx, int sy, T pad_val = 0 ) const
+    {
+        return view().get_shift( sx, sy, pad_val, get_allocator() );
+    }
+
+    tinymage_view<T> get_columns_view(     std::size_t startx,
+                                            std::size_t stopx ) const
+    {
+        return view().get_columns_view( startx, stopx );
+    }
+
+    tinymage_view<T> get_lines_view(   std::size_t starty,
+                                        std::size_t stopy ) const
+    {
+        return view().get_lines_view( starty, stopy );
+    }
+
+    tinymage get_columns(   std::size_t startx,
+                            std::size_t stopx ) const
+    {
+        return get_columns_view( startx, stopx ).materialize( get_allocator() );
+    }
+
+    tinymage get_lines( std::size_t starty,
+                        std::size_t stopy ) const
+    {
+        return get_lines_view( starty, stopy ).materialize( get_allocator() );
+    }
+
+    template<typename U = T>
+    tinymage_if_float<U> get_dline() const
+    {
+        return view().get_dline();
+    }
+
+    template<typename U = T>
+    tinymage_if_float<U> get_dcolumn() const
+    {
+        return view().get_dcolumn();
+    }
+
+    // in place, lines are moved towards the end of the buffer which is only reallocated if too small
+    void canvas_resize( std::size_t nsx, std::size_t nsy, float centering_x = 0.5f, float centering_y = 0.5f )
+    {
+        assert( nsx >= m_width && nsy >= m_height );
+        assert( centering_x <= 1.f && centering_x >= 0.f );
+        assert( centering_y <= 1.f && centering_y >= 0.f );
+
+        const auto sx = m_width;
+        const auto sy = m_height;
+        const auto old_stride = m_stride;
+        const std::size_t   xc{ static_cast<std::size_t>( static_cast<int32_t>( centering_x * ( nsx - sx ) ) ) },
+                            yc{ static_cast<std::size_t>( static_cast<int32_t>( centering_y * ( nsy - sy ) ) ) };
+
+        reshape( nsx, nsy );
+
+        // last lines first, each line landing at or after its old place, past the lines still to be moved
+        for ( auto y = sy; y-- > 0; )
+        {
+            const T* in = data() + old_stride*y;
+            T* out = line( y + yc ) + xc;
+            if ( in != out )
+                std::copy_backward( in, in + sx, out + sx );
+        }
+
+        tinymage_forY( (*this), y )
+        {
+            T* out = line( y );
+            if ( y < yc || y >= yc + sy )
+            {
+                std::fill( out, out + nsx, T(0) );
+                continue;
+            }
+            std::fill( out, out + xc, T(0) );
+            std::fill( out + xc + sx, out + nsx, T(0) );
+        }
+    }
+
+    tinymage get_canvas_resize( std::size_t nsx, std::size_t nsy, float centering_x = 0.5f, float centering_y = 0.5f  ) const
+    {
+        return view().get_canvas_resize( nsx, nsy, centering_x, centering_y, get_allocator() );
+    }
+
+    // resampling needs a second buffer, see tinymage_view::resize_into to keep one across calls
+    void resize( std::size_t nsx, std::size_t nsy, std::size_t nb_threads = 1 )
+    {
+        *this = get_resize( nsx, nsy, nb_threads );
+    }
+
+    tinymage get_resize( std::size_t nsx, std::size_t nsy, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_resize( nsx, nsy, nb_threads, get_allocator() );
+    }
+
+    template<typename U = T>
+    tinymage_if_float<U> line_sums( std::size_t nb_threads = 1 ) const
+    {
+        return view().line_sums( nb_threads );
+    }
+
+    template<typename U = T>
+    tinymage_if_float<U> row_sums( std::size_t nb_threads = 1 ) const
+    {
+        return view().row_sums( nb_threads );
+    }
+
+    template<typename U = T>
+    tinymage_if_pair_float<U> line_row_sums( std::size_t nb_threads = 1 ) const
+    {
+        return view().line_row_sums( nb_threads );
+    }
+
+    template<std::size_t nb_bins>
+    std::array<std::size_t,nb_bins> get_histogram( std::size_t nb_threads = 1 ) const
+    {
+        return view().template get_histogram<nb_bins>( nb_threads );
+    }
+
+    tinymage get_auto_threshold(   tinymage_types::threshold_method method = tinymage_types::threshold_method::isodata,
+                                    std::size_t nb_threads = 1 ) const
+    {
+        tinymage output( *this );
+        output.auto_threshold( method, nb_threads );
+        return output;
+    }
+
+    // in place filters, see tinymage_view::get_convolve
+    template<std::size_t NX, std::size_t NY>
+    void convolve( const std::array<float,NX>& kernel_x, const std::array<float,NY>& kernel_y,
+                   tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_convolve( kernel_x, kernel_y, border, nb_threads, get_allocator() );
+    }
+
+    template<std::size_t NX, std::size_t NY>
+    tinymage get_convolve( const std::array<float,NX>& kernel_x, const std::array<float,NY>& kernel_y,
+                           tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_convolve( kernel_x, kernel_y, border, nb_threads, get_allocator() );
+    }
+
+    template<std::size_t R>
+    void gaussian( float sigma, tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 )
+    {
+        *this = view().template get_gaussian<R>( sigma, border, nb_threads, get_allocator() );
+    }
+
+    template<std::size_t R>
+    tinymage get_gaussian( float sigma, tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 ) const
+    {
+        return view().template get_gaussian<R>( sigma, border, nb_threads, get_allocator() );
+    }
+
+    void box_blur( std::size_t rx, std::size_t ry, tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_box_blur( rx, ry, border, nb_threads, get_allocator() );
+    }
+
+    tinymage get_box_blur( std::size_t rx, std::size_t ry, tinymage_types::border_policy border = tinymage_types::border_policy::clamp, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_box_blur( rx, ry, border, nb_threads, get_allocator() );
+    }
+
+    // in place morphology, see tinymage_view::get_erode
+    void erode( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_erode( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_erode( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_erode( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void dilate( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_dilate( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_dilate( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_dilate( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void open( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_open( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_open( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_open( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void close( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_close( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_close( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_close( kx, ky, nb_threads, get_allocator() );
+    }
+
+    // in place bit-parallel morphology of binary images, see tinymage_view::get_binary_erode
+    void binary_erode( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_binary_erode( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_binary_erode( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_binary_erode( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void binary_dilate( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_binary_dilate( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_binary_dilate( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_binary_dilate( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void binary_open( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_binary_open( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_binary_open( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_binary_open( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void binary_close( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 )
+    {
+        *this = view().get_binary_close( kx, ky, nb_threads, get_allocator() );
+    }
+
+    tinymage get_binary_close( std::size_t kx, std::size_t ky, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_binary_close( kx, ky, nb_threads, get_allocator() );
+    }
+
+    void auto_threshold(    tinymage_types::threshold_method method = tinymage_types::threshold_method::isodata,
+                            std::size_t nb_threads = 1 )
+    {
+        threshold( static_cast<T>( view()._auto_threshold_value( method, nb_threads ) ), nb_threads );
+    }
+
+    // returns [0...255] clamped image
+    template<typename U = T>
+    std::enable_if_t<std::is_same<U, unsigned char>::value, tinymage> get_sobel( std::size_t nb_threads = 1 ) const
+    {
+        return view().get_sobel( nb_threads, get_allocator() );
+    }
+
+    template<typename U = T>
+    std::enable_if_t<std::is_same<U, unsigned char>::value, T> get_sobel_max( std::size_t nb_threads = 1 ) const
+    {
+        return view().get_sobel_max( nb_threads );
+    }
+
+    // same as tinymage_binary( get_sobel(), thresh ).line_row_sums(), without any intermediate image
+    template<typename U = T, typename A = std::allocator<float>>
+    std::enable_if_t<std::is_same<U, unsigned char>::value, std::pair<tinymage<float,A>,tinymage<float,A>>>
+    get_sobel_line_row_sums( T thresh, std::size_t nb_threads = 1, const A& alloc = A() ) const
+    {
+        return view().template get_sobel_line_row_sums<U,float,A>( thresh, nb_threads, alloc );
+    }
+
+    template<typename U = T>
+    tinymage_if_uchar<U> get_sobel_ref() const
+    {
+        return view().get_sobel_ref();
+    }
+
+    tinymage get_rotate( float angle, T pad_val = 0, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_rotate( angle, pad_val, nb_threads, get_allocator() );
+    }
+
+    tinymage get_warp(  const tinymage_types::quad_coord_t& in_coords,
+                        const tinymage_types::quad_coord_t& out_coords,
+                        std::size_t nb_threads = 1 ) const
+	{
+        return view().get_warp( in_coords, out_coords, nb_threads, get_allocator() );
+	}
+
+    tinymage get_transform( const tinymage_types::transform_t& tr, T pad_val = 0, std::size_t nb_threads = 1 ) const
+    {
+        return view().get_transform( tr, pad_val, nb_threads, get_allocator() );
+    }
+
+    void display() const
+    {
+#ifdef USE_CIMG
+        if ( m_stride != m_width )
+        {
+            view().materialize().display();
+            return;
+        }
+        const cimg_library::CImg<T> cimg( data(), static_cast<int>( m_width ), static_cast<int>( m_height ), 1, 1, true/*shared*/ );
+        cimg.display();
+#else
+        // NOT IMPLEMENTED YET
+#endif
+    }
+
+private:
+    std::size_t m_width;
+    std::size_t m_height;
+    std::size_t m_stride;
+
+    constexpr static T m_zero{ 0 };
+    constexpr static T m_one{ 1 };
+
+private:
+
+    // bytes per pixel and channels offsets of an interleaved format
+    struct pixel_layout
+    {
+        std::size_t bpp;
+        std::size_t r, g, b;
+    };
+
+    static pixel_layout _get_layout( tinymage_types::pixel_format format )
+    {
+        switch ( format )
+        {
+        case tinymage_types::pixel_format::gray: return { 1, 0, 0, 0 };
+        case tinymage_types::pixel_format::rgb:  return { 3, 0, 1, 2 };
+        case tinymage_types::pixel_format::bgr:  return { 3, 2, 1, 0 };
+        case tinymage_types::pixel_format::rgba: return { 4, 0, 1, 2 };
+        case tinymage_types::pixel_format::bgra: return { 4, 2, 1, 0 };
+        }
+        return { 1, 0, 0, 0 };
+    }
+
+    // luma of width source pixels, stored in out or added to it
+    // -> 4 bytes formats are deinterleaved with shifts and masks on 32 bits lanes, 8 (AVX2) or 4 (SSE) pixels at a time
+    template<bool accumulate>
+    static void _luma_line( const uint8_t* src, std::size_t width, const pixel_layout& layout, float* out )
+    {
+        constexpr float wr = 0.2126f, wg = 0.7152f, wb = 0.0722f;
+
+        if ( layout.bpp == 1 )
+        {
+            for ( std::size_t x = 0; x < width; ++x )
+                out[x] = accumulate ? out[x] + src[x] : static_cast<float>( src[x] );
+            return;
+        }
+
+        std::size_t x = 0;
+        if ( layout.bpp == 4 )
+        {
+#if defined(TINYMAGE_USE_AVX2)
+            {
+                const auto mask = _mm256_set1_epi32( 0xFF );
+                const auto shift_r = _mm_cvtsi32_si128( static_cast<int>( 8 * layout.r ) );
+                const auto shift_g = _mm_cvtsi32_si128( static_cast<int>( 8 * layout.g ) );
+                const auto shift_b = _mm_cvtsi32_si128( static_cast<int>( 8 * layout.b ) );
+                for ( ; x + 8 <= width; x += 8 )
+                {
+                    const auto px = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + 4*x ) );
+                    const auto r = _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srl_epi32( px, shift_r ), mask ) );
+                    const auto g = _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srl_epi32( px, shift_g ), mask ) );
+                    const auto b = _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srl_epi32( px, shift_b ), mask ) );
+                    auto luma = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r, _mm256_set1_ps( wr ) ), _mm256_mul_ps( g, _mm256_set1_ps( wg ) ) ),
+                                               _mm256_mul_ps( b, _mm256_set1_ps( wb ) ) );
+                    if ( accumulate )
+                        luma = _mm256_add_ps( luma, _mm256_loadu_ps( out + x ) );
+                    _mm256_storeu_ps( out + x, luma );
+                }
+            }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+            {
+                const auto mask = _mm_set1_epi32( 0xFF );
+                const auto shift_r = _mm_cvtsi32_si128( static_cast<int>( 8 * layout.r ) );
+                const auto shift_g = _mm_cvtsi32_si128( static_cast<int>( 8 * layout.g ) );
+                const auto shift_b = _mm_cvtsi32_si128( static_cast<int>( 8 * layout.b ) );
+                for ( ; x + 4 <= width; x += 4 )
+                {
+                    const auto px = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 4*x ) );
+                    const auto r = _mm_cvtepi32_ps( _mm_and_si128( _mm_srl_epi32( px, shift_r ), mask ) );
+                    const auto g = _mm_cvtepi32_ps( _mm_and_si128( _mm_srl_epi32( px, shift_g ), mask ) );
+                    const auto b = _mm_cvtepi32_ps( _mm_and_si128( _mm_srl_epi32( px, shift_b ), mask ) );
+                    auto luma = _mm_add_ps( _mm_add_ps( _mm_mul_ps( r, _mm_set1_ps( wr ) ), _mm_mul_ps( g, _mm_set1_ps( wg ) ) ),
+                                            _mm_mul_ps( b, _mm_set1_ps( wb ) ) );
+                    if ( accumulate )
+                        luma = _mm_add_ps( luma, _mm_loadu_ps( out + x ) );
+                    _mm_storeu_ps( out + x, luma );
+                }
+            }
+#endif
+        }
+
+        for ( ; x < width; ++x )
+        {
+            const uint8_t* px = src + layout.bpp * x;
+            const auto luma = px[layout.r] * wr + px[layout.g] * wg + px[layout.b] * wb;
+            out[x] = accumulate ? out[x] + luma : luma;
+        }
+    }
+
+    // lines stride of a sx wide image, rounded up to the allocator row alignment
+    static std::size_t _padded_stride( std::size_t sx )
+    {
+        constexpr auto align = std::max( std::size_t(1), tinymage_types::row_alignment<Alloc>::value / sizeof(T) );
+        return ( sx + align - 1 ) / align * align;
+    }
+
+    // fills the m_width x m_height pixels from lines distant of src_stride elements in src
+    template<typename U>
+    void _assign_lines( const U* src, std::size_t src_stride )
+    {
+        // plain copies of contiguous buffers skip the initialization of the new pixels
+        if ( std::is_same<T,U>::value && m_stride == m_width && src_stride == m_width )
+        {
+            assign( src, src + m_width*m_height );
+            return;
+        }
+
+        std::vector<T,Alloc>::resize( m_stride*m_height );
+        tinymage_forY( (*this), y )
+            tinymage_view<U>::_convert_line( src + src_stride*y, line( y ), m_width );
+    }
+
+ private:
+
+     template <typename F, typename A>
+     friend tinymage<F,A> operator-( const F& val, const tinymage<F,A>& t );
+};
+
+template <typename T, typename A>
+inline tinymage<T,A> operator-( const T& val, const tinymage<T,A>& t )
+{
+    tinymage<T,A> output( t );
+    output.apply( [&]( T& tval )
+        {
+            tval = val - tval;
+        });
+    return output;
+}
+
+template <typename T>
+inline tinymage<T> operator-( const T& val, const tinymage_view<T>& t )
+{
+    return val - t.materialize();
+}
+
+// 1 bit per pixel binary image, each line being packed in 64 bits words (pixel x is bit x%64 of word x/64)
+// -> 32x smaller than float masks, projections count set bits instead of adding pixels one by one
+// -> bits past the width of each line are always kept cleared
+class tinymage_binary final
+{
+public:
+    tinymage_binary() : m_width{0}, m_height{0}, m_words{0} {}
+    tinymage_binary( std::size_t sx, std::size_t sy, bool val = false )
+        : m_width{sx}, m_height{sy}, m_words{ ( sx + 63 ) / 64 }, m_bits( m_words * sy, val ? ~uint64_t(0) : 0 )
+    {
+        _clear_tails();
+    }
+
+    // pixels above thresh are set, as tinymage::threshold does
+    // -> float and 8 bits lines are compared and packed with SSE/AVX2 movemasks, lines may be packed concurrently
+    template<typename T>
+    tinymage_binary( const tinymage_view<T>& src, T thresh, std::size_t nb_threads = 1 )
+        : tinymage_binary( src.width(), src.height() )
+    {
+        tinyutils::parallel_for( m_height, src._nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                    _pack_line( src.line( y ), thresh, line( y ) );
+            });
+    }
+
+    // non zero pixels of a lazy expression are set, e.g. tinymage_binary( img.lazy().threshold( 40 ) )
+    template<typename T, typename F>
+    explicit tinymage_binary( const tinymage_expr<T,F>& e, std::size_t nb_threads = 1 )
+        : tinymage_binary( e.width(), e.height() )
+    {
+        e._for_each_band( nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const T* in = e.m_src.line( y );
+                    uint64_t* out = line( y );
+                    tinymage_forX( (*this), x )
+                        if ( e.m_func( in[x] ) )
+                            out[x/64] |= uint64_t(1) << ( x%64 );
+                }
+            });
+    }
+
+    // 8 bits sources : the expression is tabulated, a table set above some value ( any chain ending with a threshold
+    // of a non decreasing mapping ) is packed as a plain threshold of the source
+    template<typename F>
+    explicit tinymage_binary( const tinymage_expr<unsigned char,F>& e, std::size_t nb_threads = 1 )
+        : tinymage_binary( e.width(), e.height() )
+    {
+        std::array<bool,256> set;
+        const auto table = e._table();
+        std::transform( table.begin(), table.end(), set.begin(), []( const typename tinymage_expr<unsigned char,F>::value_type& val ) { return val != 0; } );
+
+        const auto first = std::find( set.begin(), set.end(), true );
+        const bool step = std::find( first, set.end(), false ) == set.end();
+        if ( first == set.end() )
+            return;
+
+        e._for_each_band( nb_threads, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    const unsigned char* in = e.m_src.line( y );
+                    uint64_t* out = line( y );
+                    if ( step && first != set.begin() )
+                    {
+                        _pack_line( in, static_cast<unsigned char>( first - set.begin() - 1 ), out );
+                        continue;
+                    }
+                    tinymage_forX( (*this), x )
+                        if ( set[ in[x] ] )
+                            out[x/64] |= uint64_t(1) << ( x%64 );
+                }
+            });
+    }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+    std::size_t size() const { return m_width * m_height; }
+
+    // number of words of each line
+    std::size_t words_per_line() const { return m_words; }
+
+    uint64_t* line( std::size_t y ) { return m_bits.data() + m_words*y; }
+    const uint64_t* line( std::size_t y ) const { return m_bits.data() + m_words*y; }
+
+    bool at( std::size_t x, std::size_t y ) const
+    {
+        return ( line( y )[x/64] >> ( x%64 ) ) & 1;
+    }
+
+    void set( std::size_t x, std::size_t y, bool val )
+    {
+        auto& word = line( y )[x/64];
+        word = val ? word | ( uint64_t(1) << ( x%64 ) ) : word & ~( uint64_t(1) << ( x%64 ) );
+    }
+
+    // number of set pixels
+    std::size_t count() const
+    {
+        return std::accumulate( m_bits.begin(), m_bits.end(), std::size_t(0),
+            []( std::size_t sum, uint64_t word ) { return sum + tinyutils::popcount( word ); } );
+    }
+
+    // set pixels count of each line, as a 1 x height image like tinymage::line_sums
+    tinymage<float> line_sums( std::size_t nb_threads = 1 ) const
+    {
+        tinymage<float> output( 1, m_height, 0.f );
+
+        tinyutils::parallel_for( m_height, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    std::size_t sum = 0;
+                    for ( std::size_t i = 0; i < m_words; ++i )
+                        sum += tinyutils::popcount( line( y )[i] );
+                    output[y] = static_cast<float>( sum );
+                }
+            });
+
+        return output;
+    }
+
+    // set pixels count of each column, as a width x 1 image like tinymage::row_sums
+    // -> lines are added word-wise into bit-sliced counters (bit plane p holding the 2^p bit of 64 columns counts),
+    //    which costs two word operations per line word on average
+    // -> words columns bands may be counted concurrently by nb_threads threads
+    tinymage<float> row_sums( std::size_t nb_threads = 1 ) const
+    {
+        tinymage<float> output( m_width, 1, 0.f );
+
+        std::size_t nb_planes = 1;
+        while ( ( std::size_t(1) << nb_planes ) <= m_height )
+            ++nb_planes;
+
+        tinyutils::parallel_for( m_words, _nb_tasks( nb_threads ), [&]( std::size_t start, std::size_t stop )
+            {
+                const auto band = stop - start;
+                std::vector<uint64_t> planes( nb_planes * band, 0 );
+                for ( std::size_t y = 0; y < m_height; ++y )
+                {
+                    const uint64_t* in = line( y ) + start;
+                    for ( std::size_t i = 0; i < band; ++i )
+                    {
+                        // ripple carry addition of one bit per column
+                        auto carry = in[i];
+                        for ( std::size_t p = 0; carry && p < nb_planes; ++p )
+                        {
+                            auto& plane = planes[ p*band + i ];
+                            const auto next_carry = plane & carry;
+                            plane ^= carry;
+                            carry = next_carry;
+                        }
+                    }
+                }
+
+                for ( std::size_t i = 0; i < band; ++i )
+                    for ( std::size_t b = 0, x = 64*( start + i ); b < 64 && x < m_width; ++b, ++x )
+                    {
+                        std::size_t sum = 0;
+                        for ( std::size_t p = 0; p < nb_planes; ++p )
+                            sum |= ( ( planes[ p*band + i ] >> b ) & 1 ) << p;
+                        output[x] = static_cast<float>( sum );
+                    }
+            });
+
+        return output;
+    }
+
+    std::pair<tinymage<float>,tinymage<float>> line_row_sums( std::size_t nb_threads = 1 ) const
+    {
+        return std::make_pair( line_sums( nb_threads ), row_sums( nb_threads ) );
+    }
+
+    // mean abscissa of the set pixels of a line
+    float line_centroid( std::size_t y ) const
+    {
+        auto _mean = 0.f;
+        auto _total = 0.f;
+        for ( std::size_t i = 0; i < m_words; ++i )
+            for ( auto word = line( y )[i]; word; word &= word - 1 )
+            {
+                _mean += static_cast<float>( 64*i + tinyutils::count_trailing_zeros( word ) );
+                _total += 1.f;
+            }
+        return _mean / _total;
+    }
+
+    tinymage_binary& operator&=( const tinymage_binary& other )
+    {
+        return _combine( other, []( uint64_t a, uint64_t b ) { return a & b; } );
+    }
+
+    tinymage_binary& operator|=( const tinymage_binary& other )
+    {
+        return _combine( other, []( uint64_t a, uint64_t b ) { return a | b; } );
+    }
+
+    tinymage_binary& operator^=( const tinymage_binary& other )
+    {
+        return _combine( other, []( uint64_t a, uint64_t b ) { return a ^ b; } );
+    }
+
+    tinymage_binary operator~() const
+    {
+        tinymage_binary output( *this );
+        for ( auto& word : output.m_bits )
+            word = ~word;
+        output._clear_tails();
+        return output;
+    }
+
+    // 0/1 pixels image
+    template<typename T = float>
+    tinymage<T> convert() const
+    {
+        tinymage<T> output( m_width, m_height );
+        tinymage_forY( (*this), y )
+        {
+            T* out = output.line( y );
+            tinymage_forX( (*this), x )
+                out[x] = at( x, y ) ? T{1} : T{0};
+        }
+        return output;
+    }
+
+    void display() const
+    {
+#ifdef USE_CIMG
+        convert<unsigned char>().display();
+#endif
+    }
+
+private:
+
+    // run length encoded masks scan the words directly
+    friend class tinymage_rle;
+
+    std::size_t _nb_tasks( std::size_t nb_threads ) const
+    {
+        return tinymage_view<uint64_t>( m_bits.data(), m_words, m_height )._nb_tasks( nb_threads );
+    }
+
+    void _clear_tails()
+    {
+        if ( m_width % 64 == 0 )
+            return;
+        const auto mask = ( uint64_t(1) << ( m_width % 64 ) ) - 1;
+        tinymage_forY( (*this), y )
+            line( y )[m_words-1] &= mask;
+    }
+
+    template<typename Op>
+    tinymage_binary& _combine( const tinymage_binary& other, Op op )
+    {
+        assert( other.m_width == m_width && other.m_height == m_height );
+        std::transform( m_bits.begin(), m_bits.end(), other.m_bits.begin(), m_bits.begin(), op );
+        return *this;
+    }
+
+    template<typename T>
+    void _pack_line( const T* in, T thresh, uint64_t* out ) const
+    {
+        const auto full_words = m_width / 64;
+        for ( std::size_t i = 0; i < full_words; ++i )
+            out[i] = _pack_word( in + 64*i, thresh );
+
+        for ( std::size_t x = 64*full_words; x < m_width; ++x )
+            if ( in[x] > thresh )
+                out[x/64] |= uint64_t(1) << ( x%64 );
+    }
+
+    template<typename T>
+    static uint64_t _pack_word( const T* in, T thresh )
+    {
+        uint64_t word = 0;
+        for ( std::size_t b = 0; b < 64; ++b )
+            word |= uint64_t( in[b] > thresh ) << b;
+        return word;
+    }
+
+    static uint64_t _pack_word( const float* in, float thresh )
+    {
+#if defined(TINYMAGE_USE_AVX2)
+        uint64_t word = 0;
+        const auto t = _mm256_set1_ps( thresh );
+        for ( std::size_t b = 0; b < 64; b += 8 )
+            word |= uint64_t( _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( in + b ), t, _CMP_GT_OQ ) ) ) << b;
+        return word;
+#elif defined(TINYMAGE_USE_SSE)
+        uint64_t word = 0;
+        const auto t = _mm_set1_ps( thresh );
+        for ( std::size_t b = 0; b < 64; b += 4 )
+            word |= uint64_t( _mm_movemask_ps( _mm_cmpgt_ps( _mm_loadu_ps( in + b ), t ) ) ) << b;
+        return word;
+#else
+        return _pack_word<float>( in, thresh );
+#endif
+    }
+
+    static uint64_t _pack_word( const unsigned char* in, unsigned char thresh )
+    {
+#if defined(TINYMAGE_USE_SSE)
+        // unsigned comparison through signed compare of values biased by 0x80
+        uint64_t word = 0;
+        const auto bias = _mm_set1_epi8( static_cast<char>( 0x80 ) );
+        const auto t = _mm_xor_si128( _mm_set1_epi8( static_cast<char>( thresh ) ), bias );
+        for ( std::size_t b = 0; b < 64; b += 16 )
+        {
+            const auto v = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + b ) ), bias );
+            word |= uint64_t( static_cast<std::uint16_t>( _mm_movemask_epi8( _mm_cmpgt_epi8( v, t ) ) ) ) << b;
+        }
+        return word;
+#else
+        return _pack_word<unsigned char>( in, thresh );
+#endif
+    }
+
+private:
+    std::size_t m_width;
+    std::size_t m_height;
+    std::size_t m_words;
+    std::vector<uint64_t> m_bits;
+};
+
+inline tinymage_binary operator&( tinymage_binary a, const tinymage_binary& b ) { return a &= b; }
+inline tinymage_binary operator|( tinymage_binary a, const tinymage_binary& b ) { return a |= b; }
+inline tinymage_binary operator^( tinymage_binary a, const tinymage_binary& b ) { return a ^= b; }
+
+// run length encoded binary image : the set pixels of each line are stored as [x0,x1[ runs, lines after lines
+// -> large uniform regions (signs, digits strokes) cost a few runs per line, whatever the resolution
+// -> labeling, bounding boxes, areas and projections walk the runs, not the pixels
+class tinymage_rle final
+{
+public:
+    tinymage_rle() : m_width{0}, m_height{0}, m_lines( 1, 0 ) {}
+
+    // pixels above thresh are set, as tinymage::threshold does
+    // -> lines may be encoded concurrently by nb_threads threads
+    template<typename T>
+    tinymage_rle( const tinymage_view<T>& src, T thresh, std::size_t nb_threads = 1 )
+        : m_width{ src.width() }, m_height{ src.height() }
+    {
+        _encode( src._nb_tasks( nb_threads ), [&]( std::size_t y, auto emit )
+            {
+                const T* in = src.line( y );
+                _scan_pixels( m_width, [in,thresh]( std::size_t x ) { return in[x] > thresh; }, emit );
+            });
+    }
+
+    // non zero pixels of a lazy expression are set
+    template<typename T, typename F>
+    explicit tinymage_rle( const tinymage_expr<T,F>& e, std::size_t nb_threads = 1 )
+        : m_width{ e.width() }, m_height{ e.height() }
+    {
+        _encode( e.m_src._nb_tasks( nb_threads ), [&]( std::size_t y, auto emit )
+            {
+                const T* in = e.m_src.line( y );
+                _scan_pixels( m_width, [&]( std::size_t x ) { return static_cast<bool>( e.m_func( in[x] ) ); }, emit );
+            });
+    }
+
+    // runs bounds are found from the words transitions, 64 pixels at a time
+    explicit tinymage_rle( const tinymage_binary& src, std::size_t nb_threads = 1 )
+        : m_width{ src.width() }, m_height{ src.height() }
+    {
+        _encode( src._nb_tasks( nb_threads ), [&]( std::size_t y, auto emit )
+            {
+                _scan_words( src.line( y ), src.words_per_line(), m_width, emit );
+            });
+    }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+    std::size_t size() const { return m_width * m_height; }
+
+    // total number of runs
+    std::size_t nb_runs() const { return m_runs.size(); }
+
+    // [first,last[ runs of a line, ordered by abscissa
+    std::pair<const tinymage_types::run_t*,const tinymage_types::run_t*> line( std::size_t y ) const
+    {
+        return std::make_pair( m_runs.data() + m_lines[y], m_runs.data() + m_lines[y+1] );
+    }
+
+    // number of set pixels
+    std::size_t count() const
+    {
+        return std::accumulate( m_runs.begin(), m_runs.end(), std::size_t(0),
+            []( std::size_t sum, const tinymage_types::run_t& r ) { return sum + r.x1 - r.x0; } );
+    }
+
+    // set pixels count of each line, as a 1 x height image like tinymage::line_sums
+    tinymage<float> line_sums() const
+    {
+        tinymage<float> output( 1, m_height, 0.f );
+        tinymage_forY( (*this), y )
+        {
+            std::size_t sum = 0;
+            for ( auto r = line( y ).first; r != line( y ).second; ++r )
+                sum += r->x1 - r->x0;
+            output[y] = static_cast<float>( sum );
+        }
+        return output;
+    }
+
+    // set pixels count of each column, as a width x 1 image like tinymage::row_sums
+    // -> each run adds one at its start and removes one past its end, the counts being the running sum
+    tinymage<float> row_sums() const
+    {
+        std::vector<std::ptrdiff_t> deltas( m_width + 1, 0 );
+        for ( const auto& r : m_runs )
+        {
+            ++deltas[r.x0];
+            --deltas[r.x1];
+        }
+
+        tinymage<float> output( m_width, 1 );
+        std::ptrdiff_t sum = 0;
+        tinymage_forX( (*this), x )
+        {
+            sum += deltas[x];
+            output[x] = static_cast<float>( sum );
+        }
+        return output;
+    }
+
+    std::pair<tinymage<float>,tinymage<float>> line_row_sums() const
+    {
+        return std::make_pair( line_sums(), row_sums() );
+    }
+
+    // mean abscissa of the set pixels of a line
+    float line_centroid( std::size_t y ) const
+    {
+        auto _mean = 0.f;
+        auto _total = 0.f;
+        for ( auto r = line( y ).first; r != line( y ).second; ++r )
+        {
+            const auto len = static_cast<float>( r->x1 - r->x0 );
+            _mean += len * static_cast<float>( r->x0 + r->x1 - 1 ) / 2.f;
+            _total += len;
+        }
+        return _mean / _total;
+    }
+
+    // connected components of the set pixels, numbered in the raster order of their first pixel
+    // -> labels[i] receives the component of the i-th run, the components count is returned
+    // -> runs of consecutive lines are joined through a union-find when they overlap (or touch diagonally
+    //    if diagonal is true), the cost depending on the runs count only
+    std::size_t label_runs( std::vector<std::size_t>& labels, bool diagonal = false ) const
+    {
+        // union-find forest, each run pointing to a run of lower index of its component
+        labels.resize( m_runs.size() );
+        std::iota( labels.begin(), labels.end(), std::size_t(0) );
+
+        auto _find = [&labels]( std::size_t i )
+        {
+            while ( labels[i] != i )
+                i = labels[i] = labels[labels[i]];
+            return i;
+        };
+
+        const std::size_t reach = diagonal ? 1 : 0;
+        for ( std::size_t y = 1; y < m_height; ++y )
+        {
+            auto a = m_lines[y-1];
+            auto b = m_lines[y];
+            while ( a < m_lines[y] && b < m_lines[y+1] )
+            {
+                const auto& ra = m_runs[a];
+                const auto& rb = m_runs[b];
+                if ( ra.x0 < rb.x1 + reach && rb.x0 < ra.x1 + reach )
+                {
+                    const auto root_a = _find( a );
+                    const auto root_b = _find( b );
+                    labels[ std::max( root_a, root_b ) ] = std::min( root_a, root_b );
+                }
+
+                // the run ending first cannot meet the next runs of the other line
+                if ( ra.x1 < rb.x1 )
+                    ++a;
+                else
+                    ++b;
+            }
+        }
+
+        // roots are the first run of their component, parents being relabeled before their children
+        std::size_t nb_labels = 0;
+        for ( std::size_t i = 0; i < labels.size(); ++i )
+            labels[i] = labels[i] == i ? nb_labels++ : labels[labels[i]];
+
+        return nb_labels;
+    }
+
+    // bounding boxes and areas of the connected components, in the label_runs order
+    std::vector<tinymage_types::blob_t> get_blobs( bool diagonal = false ) const
+    {
+        std::vector<std::size_t> labels;
+        std::vector<tinymage_types::blob_t> blobs( label_runs( labels, diagonal ) );
+
+        tinymage_forY( (*this), y )
+        {
+            for ( auto i = m_lines[y]; i < m_lines[y+1]; ++i )
+            {
+                const auto& r = m_runs[i];
+                auto& b = blobs[labels[i]];
+                if ( b.area == 0 )
+                {
+                    b = { r.x0, y, r.x1 - 1, y, 0 };
+                }
+                else
+                {
+                    b.x0 = std::min( b.x0, r.x0 );
+                    b.x1 = std::max( b.x1, r.x1 - 1 );
+                    b.y1 = y;
+                }
+                b.area += r.x1 - r.x0;
+            }
+        }
+
+        return blobs;
+    }
+
+    // 0/1 pixels image
+    template<typename T = float>
+    tinymage<T> convert() const
+    {
+        tinymage<T> output( m_width, m_height, T{0} );
+        tinymage_forY( (*this), y )
+        {
+            T* out = output.line( y );
+            for ( auto r = line( y ).first; r != line( y ).second; ++r )
+                std::fill( out + r->x0, out + r->x1, T{1} );
+        }
+        return output;
+    }
+
+    void display() const
+    {
+#ifdef USE_CIMG
+        convert<unsigned char>().display();
+#endif
+    }
+
+private:
+
+    // scan( y, emit ) calls emit( x0, x1 ) on each run of line y, from left to right
+    // -> serial encoding appends the runs in a single pass, concurrent encoding counts the runs of each line
+    //    first, so that lines bands can then be written in place
+    template<typename Scan>
+    void _encode( std::size_t nb_tasks, Scan scan )
+    {
+        m_lines.assign( m_height + 1, 0 );
+        m_runs.clear();
+
+        if ( nb_tasks <= 1 || tinyutils::thread_pool::is_worker() )
+        {
+            for ( std::size_t y = 0; y < m_height; ++y )
+            {
+                scan( y, [this]( std::size_t x0, std::size_t x1 ) { m_runs.push_back( { x0, x1 } ); } );
+                m_lines[y+1] = m_runs.size();
+            }
+            return;
+        }
+
+        tinyutils::parallel_for( m_height, nb_tasks, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    std::size_t nb = 0;
+                    scan( y, [&nb]( std::size_t, std::size_t ) { ++nb; } );
+                    m_lines[y+1] = nb;
+                }
+            });
+
+        std::partial_sum( m_lines.begin(), m_lines.end(), m_lines.begin() );
+        m_runs.resize( m_lines.back() );
+
+        tinyutils::parallel_for( m_height, nb_tasks, [&]( std::size_t start, std::size_t stop )
+            {
+                for ( auto y = start; y < stop; ++y )
+                {
+                    auto out = m_runs.begin() + m_lines[y];
+                    scan( y, [&out]( std::size_t x0, std::size_t x1 ) { *out++ = { x0, x1 }; } );
+                }
+            });
+    }
+
+    template<typename Pred, typename Emit>
+    static void _scan_pixels( std::size_t width, Pred is_set, Emit emit )
+    {
+        std::size_t x = 0;
+        while ( x < width )
+        {
+            while ( x < width && !is_set( x ) )
+                ++x;
+            if ( x == width )
+                break;
+
+            const auto x0 = x;
+            while ( x < width && is_set( x ) )
+                ++x;
+            emit( x0, x );
+        }
+    }
+
+    // each set bit of word ^ ( word << 1 ) is a run bound, alternately a start and an end
+    template<typename Emit>
+    static void _scan_words( const uint64_t* words, std::size_t nb_words, std::size_t width, Emit emit )
+    {
+        std::size_t x0 = 0;
+        bool inside = false;
+        uint64_t carry = 0;
+        for ( std::size_t i = 0; i < nb_words; ++i )
+        {
+            auto edges = words[i] ^ ( ( words[i] << 1 ) | carry );
+            carry = words[i] >> 63;
+            for ( ; edges; edges &= edges - 1 )
+            {
+                const auto x = 64*i + tinyutils::count_trailing_zeros( edges );
+                if ( inside )
+                    emit( x0, x );
+                else
+                    x0 = x;
+                inside = !inside;
+            }
+        }
+        if ( inside )
+            emit( x0, width );
+    }
+
+private:
+    std::size_t m_width;
+    std::size_t m_height;
+    std::vector<std::size_t> m_lines;   // runs of line y are [ m_lines[y], m_lines[y+1] [
+    std::vector<tinymage_types::run_t> m_runs;
+};
+
+// successive half resolution levels of an image, level 0 being the image itself (viewed, not copied)
+// -> levels buffers are reused when built again from an image of the same size
+// -> level i pixel ( x, y ) covers the 2^i x 2^i source block starting at ( x*2^i, y*2^i )
+template<typename T=float>
+class tinymage_pyramid final
+{
+public:
+
+    // nb_levels half resolution levels are built, less if the image gets smaller than 2x2
+    void build( const tinymage_view<T>& src, std::size_t nb_levels,
+                tinymage_types::pyramid_filter filter = tinymage_types::pyramid_filter::box, std::size_t nb_threads = 1 )
+    {
+        m_base = src;
+        m_levels.resize( nb_levels );
+
+        auto count = std::size_t(0);
+        for ( auto prev = src; count < nb_levels && prev.width() >= 2 && prev.height() >= 2; prev = m_levels[count++].view() )
+            prev.pyr_down_into( m_levels[count], filter, nb_threads );
+        m_levels.resize( count );
+    }
+
+    // number of levels, including the base one
+    std::size_t size() const { return m_levels.size() + 1; }
+
+    tinymage_view<T> level( std::size_t index ) const
+    {
+        assert( index < size() );
+        return index == 0 ? m_base : m_levels[index-1].view();
+    }
+
+    static constexpr std::size_t scale( std::size_t index ) { return std::size_t(1) << index; }
+
+private:
+    tinymage_view<T> m_base;
+    std::vector<tinymage<T>> m_levels;
+};
+
+// image of compile time dimensions, its pixels being stored inline instead of allocated
+// -> suited to network input patches, loops bounded by W and H can be fully unrolled and vectorized
+// -> interoperates with the dynamic API through its view
+template<typename T, std::size_t W, std::size_t H>
+class tinymage_fixed final
+{
+public:
+
+    tinymage_fixed() : m_pixels{} {} // zero init
+    explicit tinymage_fixed( T val ) { m_pixels.fill( val ); }
+
+    // copies the pixels of a view of the same dimensions
+    explicit tinymage_fixed( const tinymage_view<T>& view )
+    {
+        assert( view.width() == W && view.height() == H );
+        tinymage_forY( view, y )
+            std::copy( view.line( y ), view.line( y ) + W, line( y ) );
+    }
+
+    static constexpr std::size_t width() { return W; }
+    static constexpr std::size_t height() { return H; }
+    static constexpr std::size_t size() { return W * H; }
+    static constexpr std::size_t stride() { return W; }
+
+    T* data() { return m_pixels.data(); }
+    const T* data() const { return m_pixels.data(); }
+
+    T* line( std::size_t y ) { return data() + W*y; }
+    const T* line( std::size_t y ) const { return data() + W*y; }
+
+    T& operator[]( std::size_t i ) { return m_pixels[i]; }
+    const T& operator[]( std::size_t i ) const { return m_pixels[i]; }
+
+    T& at( std::size_t x, std::size_t y ) { return m_pixels[ x + W*y ]; }
+    const T& c_at( std::size_t x, std::size_t y ) const { return m_pixels[ x + W*y ]; }
+
+    tinymage_view<T> view() const
+    {
+        return tinymage_view<T>( data(), W, H );
+    }
+
+    operator tinymage_view<T>() const
+    {
+        return view();
+    }
+
+    template<typename A = std::allocator<T>>
+    tinymage<T,A> materialize( const A& alloc = A() ) const
+    {
+        return tinymage<T,A>( view(), alloc );
+    }
+
+    void fill( T val )
+    {
+        m_pixels.fill( val );
+    }
+
+    template<typename Func>
+    void apply( Func f )
+    {
+        std::for_each( m_pixels.begin(), m_pixels.end(), f );
+    }
+
+    void threshold( T thresh )
+    {
+        for ( auto& val : m_pixels )
+            val = val > thresh ? T{1} : T{0};
+    }
+
+    // same mapping as tinymage::normalize
+    void normalize( T min, T max )
+    {
+        assert( max > min );
+
+        const auto mm = std::minmax_element( m_pixels.begin(), m_pixels.end() );
+        const auto cur_min = *mm.first;
+        const auto cur_max = *mm.second;
+
+        assert( cur_max > cur_min );
+
+        const double cur_dyn = cur_max - cur_min;
+        const double out_dyn = max - min;
+
+        for ( auto& val : m_pixels )
+            val = static_cast<T>( min + ( out_dyn * ( val - cur_min ) / cur_dyn ) );
+    }
+
+    // same placement as tinymage::canvas_resize, the new dimensions being known at compile time too
+    template<std::size_t NW, std::size_t NH>
+    tinymage_fixed<T,NW,NH> get_canvas_resize( float centering_x = 0.5f, float centering_y = 0.5f ) const
+    {
+        static_assert( NW >= W && NH >= H, "canvas must be larger than the image" );
+        assert( centering_x <= 1.f && centering_x >= 0.f );
+        assert( centering_y <= 1.f && centering_y >= 0.f );
+
+        tinymage_fixed<T,NW,NH> output;
+
+        const auto xc = static_cast<std::size_t>( centering_x * ( NW - W ) );
+        const auto yc = static_cast<std::size_t>( centering_y * ( NH - H ) );
+
+        for ( std::size_t y = 0; y < H; ++y )
+            std::copy( line( y ), line( y ) + W, output.line( y + yc ) + xc );
+
+        return output;
+    }
+
+private:
+    std::array<T, W*H> m_pixels;
+};
+
+// precomputed bilinear resampling of a fixed size image through a fixed transform
+// -> source offsets and interpolation weights are computed once, applying the table is a pure gather
+// -> an integer shift may be composed after the transform, with tinymage::get_shift semantics
+class tinymage_remap final
+{
+public:
+    tinymage_remap( const tinymage_types::transform_t& tr, std::size_t sx, std::size_t sy, int shift_x = 0, int shift_y = 0 )
+        : m_width{ sx }, m_height{ sy }, m_entries( sx * sy )
+    {
+        auto entry = m_entries.begin();
+        for ( std::size_t y = 0; y < m_height; ++y )
+        {
+            const auto ty = _shift_source( y, shift_y, m_height );
+
+            // line constant terms of the numerators and denominator, as in tinymage_view::get_transform
+            const auto dy = static_cast<float>( ty ) - tr.oy;
+            const auto x0 = tr.b * dy;
+            const auto y0 = tr.e * dy;
+            const auto w0 = tr.h * dy;
+
+            for ( std::size_t x = 0; x < m_width; ++x, ++entry )
+            {
+                const auto tx = _shift_source( x, shift_x, m_width );
+                if ( tx < 0 || ty < 0 )
+                {
+                    entry->left = shifted_out;
+                    continue;
+                }
+
+                const auto dx = static_cast<float>( tx ) - tr.ox;
+                auto horizontal_position = ( tr.a * dx + x0 ) + tr.c;
+                auto vertical_position = ( tr.d * dx + y0 ) + tr.f;
+                if ( !tr.is_affine() )
+                {
+                    const auto w = ( tr.g * dx + w0 ) + 1.f;
+                    horizontal_position /= w;
+                    vertical_position /= w;
+                }
+
+                if ( !( horizontal_position >= 0.f && horizontal_position < static_cast<float>( m_width ) - 1.f &&
+                        vertical_position >= 0.f && vertical_position < static_cast<float>( m_height ) - 1.f ) )
+                    continue;
+
+                auto left = static_cast<std::size_t>( horizontal_position );
+                auto top = static_cast<std::size_t>( vertical_position );
+
+                entry->left = static_cast<std::int32_t>( left );
+                entry->top = static_cast<std::int32_t>( top );
+                entry->horizontal_progress = horizontal_position - left;
+                entry->vertical_progress = vertical_position - top;
+            }
+        }
+    }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+
+    // resamples src into dst, whose buffer is kept if large enough (see tinymage::reshape)
+    // -> src must have the table size, both src and dst lines strides are honored
+    // -> pad_val fills the pixels mapped outside of src, shift_pad_val the ones shifted out
+    template<typename T, typename A>
+    void apply( const tinymage_view<T>& src, tinymage<T,A>& dst, T pad_val = 0, T shift_pad_val = 0 ) const
+    {
+        dst.reshape( m_width, m_height );
+
+        _apply( src, dst, pad_val, shift_pad_val );
+    }
+
+    template<typename T, std::size_t W, std::size_t H>
+    void apply( const tinymage_view<T>& src, tinymage_fixed<T,W,H>& dst, T pad_val = 0, T shift_pad_val = 0 ) const
+    {
+        assert( m_width == W && m_height == H );
+
+        _apply( src, dst, pad_val, shift_pad_val );
+    }
+
+    template<typename T>
+    tinymage<T> get_remap( const tinymage_view<T>& src, T pad_val = 0, T shift_pad_val = 0 ) const
+    {
+        tinymage<T> output( m_width, m_height );
+        apply( src, output, pad_val, shift_pad_val );
+        return output;
+    }
+
+private:
+
+    // dst already has the table size
+    template<typename T, typename D>
+    void _apply( const tinymage_view<T>& src, D& dst, T pad_val, T shift_pad_val ) const
+    {
+        assert( src.width() == m_width && src.height() == m_height );
+
+        const auto src_stride = src.stride();
+        auto entry = m_entries.cbegin();
+        for ( std::size_t y = 0; y < m_height; ++y )
+        {
+            T* out = dst.line( y );
+            for ( std::size_t x = 0; x < m_width; ++x, ++entry )
+            {
+                if ( entry->left < 0 )
+                {
+                    *out++ = ( entry->left == shifted_out ) ? shift_pad_val : pad_val;
+                    continue;
+                }
+
+                const T* top_left = src.line( static_cast<std::size_t>( entry->top ) ) + entry->left;
+                const T* bottom_left = top_left + src_stride;
+
+                auto top_block = top_left[0] + entry->horizontal_progress * ( top_left[1] - top_left[0] );
+                auto bottom_block = bottom_left[0] + entry->horizontal_progress * ( bottom_left[1] - bottom_left[0] );
+
+                *out++ = static_cast<T>( top_block + entry->vertical_progress * ( bottom_block - top_block ) );
+            }
+        }
+    }
+
+    // source coordinate of an output coordinate after a get_shift like shift, -1 if padded
+    static std::ptrdiff_t _shift_source( std::size_t pos, int shift, std::size_t size )
+    {
+        const auto start = static_cast<std::size_t>( std::max( shift, 0 ) );
+        const auto stop = std::min( size, size + shift );
+        return start + pos < stop ? static_cast<std::ptrdiff_t>( start + pos ) : -1;
+    }
+
+private:
+
+    static constexpr std::int32_t outside = -1;
+    static constexpr std::int32_t shifted_out = -2;
+
+    struct entry_t
+    {
+        std::int32_t left = outside; // top left source pixel column, or one of the padding markers
+        std::int32_t top = 0;
+        float horizontal_progress = 0.f;
+        float vertical_progress = 0.f;
+    };
+
+    std::size_t m_width;
+    std::size_t m_height;
+    std::vector<entry_t> m_entries;
+};
+
+// remap tables of already met ( size, transform, shift ) combinations
+// -> not thread safe, returned references stay valid for the cache lifetime
+class tinymage_remap_cache final
+{
+public:
+    const tinymage_remap& get( const tinymage_types::transform_t& tr, std::size_t sx, std::size_t sy, int shift_x = 0, int shift_y = 0 )
+    {
+        key_t key{ sx, sy, { { tr.a, tr.b, tr.c, tr.d, tr.e, tr.f, tr.g, tr.h, tr.ox, tr.oy } }, shift_x, shift_y };
+
+        auto it = m_tables.find( key );
+        if ( it == m_tables.end() )
+            it = m_tables.emplace( key, tinymage_remap( tr, sx, sy, shift_x, shift_y ) ).first;
+        return it->second;
+    }
+
+    std::size_t size() const { return m_tables.size(); }
+    void clear() { m_tables.clear(); }
+
+private:
+    using key_t = std::tuple<std::size_t, std::size_t, std::array<float,10>, int, int>;
+
+    std::map<key_t, tinymage_remap> m_tables;
+};
+
+// separable resampling of a fixed ( source size, target size ) pair, its filter weights being computed once
+// -> same filters as the stb based get_resize : catmull-rom along enlarged axes, mitchell along the other ones,
+//    with clamped edges and weights normalized as stb_image_resize does
+// -> source lines are accumulated into a float line (vectorized for float and 8 bits images), then reduced horizontally
+// -> apply reuses an internal line buffer, so a resampler must not be shared between threads
+class tinymage_resampler final
+{
+public:
+    tinymage_resampler( std::size_t sx, std::size_t sy, std::size_t nsx, std::size_t nsy )
+        : m_width{ sx }, m_height{ sy }, m_columns( _weights( sx, nsx ) ), m_lines( _weights( sy, nsy ) ), m_line( sx )
+    {
+        assert( sx > 0 && sy > 0 && nsx > 0 && nsy > 0 );
+    }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+    std::size_t target_width() const { return m_columns.first.size(); }
+    std::size_t target_height() const { return m_lines.first.size(); }
+
+    // resamples src into dst, whose buffer is kept if large enough (see tinymage::reshape)
+    template<typename T, typename A>
+    void apply( const tinymage_view<T>& src, tinymage<T,A>& dst ) const
+    {
+        dst.reshape( target_width(), target_height() );
+
+        assert( src.width() == m_width && src.height() == m_height );
+        _apply( src, 0, 0, dst );
+    }
+
+    // source and destination types may differ, e.g. an 8 bits mask resampled into a float patch
+    template<typename S, typename T, std::size_t W, std::size_t H>
+    void apply( const tinymage_view<S>& src, tinymage_fixed<T,W,H>& dst ) const
+    {
+        assert( target_width() == W && target_height() == H );
+        assert( src.width() == m_width && src.height() == m_height );
+
+        _apply( src, 0, 0, dst );
+    }
+
+    // src is placed at ( offset_x, offset_y ) in a zero canvas of the resampler source dimensions, e.g. a ROI fitted in a square
+    // -> same result as resampling the materialized canvas, whose zero lines and columns are skipped
+    template<typename S, typename T, std::size_t W, std::size_t H>
+    void apply( const tinymage_view<S>& src, std::size_t offset_x, std::size_t offset_y, tinymage_fixed<T,W,H>& dst ) const
+    {
+        assert( target_width() == W && target_height() == H );
+
+        _apply( src, offset_x, offset_y, dst );
+    }
+
+    template<typename T>
+    tinymage<T> get_resample( const tinymage_view<T>& src ) const
+    {
+        tinymage<T> output( target_width(), target_height() );
+        apply( src, output );
+        return output;
+    }
+
+private:
+
+    // contributing source pixels of each output pixel : [first...first+count), weights starting at offset
+    struct axis_t
+    {
+        std::vector<std::uint32_t> first;
+        std::vector<std::uint32_t> count;
+        std::vector<std::uint32_t> offset;
+        std::vector<float> weights;
+    };
+
+    static float _catmull_rom( float x )
+    {
+        x = std::fabs( x );
+        if ( x < 1.f )
+            return 1 - x*x*( 2.5f - 1.5f*x );
+        if ( x < 2.f )
+            return 2 - x*( 4 + x*( 0.5f*x - 2.5f ) );
+        return 0.f;
+    }
+
+    static float _mitchell( float x )
+    {
+        x = std::fabs( x );
+        if ( x < 1.f )
+            return ( 16 + x*x*( 21*x - 36 ) ) / 18;
+        if ( x < 2.f )
+            return ( 32 + x*( -60 + x*( 36 - 7*x ) ) ) / 18;
+        return 0.f;
+    }
+
+    // stb_image_resize filter setup, both kernels having a support of 2 and the computations being kept in float
+    // -> enlarging, each output pixel gathers its source pixels, its weights summing to 1
+    // -> otherwise each source pixel, margin ones included, scatters to its output pixels, whose weights are then normalized
+    // -> weights of the source pixels past the edges are merged into the edge pixels ones
+    static axis_t _weights( std::size_t size, std::size_t new_size )
+    {
+        const auto isize = static_cast<int>( size );
+        const auto inew_size = static_cast<int>( new_size );
+        const auto scale = static_cast<float>( new_size ) / static_cast<float>( size );
+        auto clamp = [&]( int i ) { return static_cast<std::size_t>( std::min( std::max( i, 0 ), isize - 1 ) ); };
+
+        // dense output x source weights, source sizes being digit sized
+        std::vector<float> dense( new_size * size, 0.f );
+
+        if ( scale > 1.f )
+        {
+            const float radius = 2.f * scale;
+            for ( int n = 0; n < inew_size; ++n )
+            {
+                const float out_center = static_cast<float>( n ) + 0.5f;
+                const float in_center = out_center / scale;
+                const auto first = static_cast<int>( std::floor( ( out_center - radius ) / scale + 0.5 ) );
+                const auto last = static_cast<int>( std::floor( ( out_center + radius ) / scale - 0.5 ) );
+
+                std::vector<std::pair<int,float>> coefficients;
+                float total = 0.f;
+                for ( auto i = first; i <= last; ++i )
+                {
+                    const float coefficient = _catmull_rom( in_center - ( static_cast<float>( i ) + 0.5f ) );
+                    if ( coefficients.empty() && coefficient == 0.f ) // leading zeros are skipped, as stb does
+                        continue;
+                    coefficients.emplace_back( i, coefficient );
+                    total += coefficient;
+                }
+                const float filter_scale = 1.f / total;
+                for ( const auto& c : coefficients )
+                    dense[ n * size + clamp( c.first ) ] += c.second * filter_scale;
+            }
+        }
+        else
+        {
+            const float radius = 2.f / scale;
+            const int margin = static_cast<int>( std::ceil( 2.f * 2.f / scale ) ) / 2;
+            const int nb_contributors = isize + 2 * margin;
+
+            // scattered weights of each contributor, then normalized per output pixel
+            std::vector<float> scattered( nb_contributors * new_size, 0.f );
+            for ( int n = 0; n < nb_contributors; ++n )
+            {
+                const float in_center = static_cast<float>( n - margin ) + 0.5f;
+                const float out_center = in_center * scale;
+                const auto first = static_cast<int>( std::floor( ( in_center - radius ) * scale + 0.5 ) );
+                const auto last = static_cast<int>( std::floor( ( in_center + radius ) * scale - 0.5 ) );
+                for ( auto i = std::max( first, 0 ); i <= std::min( last, inew_size - 1 ); ++i )
+                    scattered[ n * new_size + i ] = _mitchell( ( static_cast<float>( i ) + 0.5f ) - out_center ) * scale;
+            }
+            for ( std::size_t i = 0; i < new_size; ++i )
+            {
+                float total = 0.f;
+                for ( int n = 0; n < nb_contributors; ++n )
+                    total += scattered[ n * new_size + i ];
+                const float filter_scale = 1.f / total;
+                for ( int n = 0; n < nb_contributors; ++n )
+                    dense[ i * size + clamp( n - margin ) ] += scattered[ n * new_size + i ] * filter_scale;
+            }
+        }
+
+        // non zero span of each output pixel
+        axis_t axis;
+        for ( std::size_t j = 0; j < new_size; ++j )
+        {
+            const auto* row = dense.data() + j * size;
+            std::size_t first = 0;
+            while ( first + 1 < size && row[first] == 0.f ) ++first;
+            std::size_t stop = size;
+            while ( stop > first + 1 && row[stop-1] == 0.f ) --stop;
+
+            axis.first.push_back( static_cast<std::uint32_t>( first ) );
+            axis.count.push_back( static_cast<std::uint32_t>( stop - first ) );
+            axis.offset.push_back( static_cast<std::uint32_t>( axis.weights.size() ) );
+            axis.weights.insert( axis.weights.end(), row + first, row + stop );
+        }
+
+        return axis;
+    }
+
+    template<typename S, typename D>
+    void _apply( const tinymage_view<S>& src, std::size_t offset_x, std::size_t offset_y, D& dst ) const
+    {
+        assert( offset_x + src.width() <= m_width && offset_y + src.height() <= m_height );
+
+        // integer pixels are rounded to nearest and saturated, the filters overshooting
+        using T = std::decay_t<decltype( *dst.line( 0 ) )>;
+        const auto round = std::is_integral<T>::value ? 0.5f : 0.f;
+        auto saturate = [=]( float val )
+            {
+                if ( !std::is_integral<T>::value )
+                    return val;
+                return std::min( std::max( val, static_cast<float>( std::numeric_limits<T>::lowest() ) ),
+                                 static_cast<float>( std::numeric_limits<T>::max() ) );
+            };
+
+        for ( std::size_t y = 0; y < target_height(); ++y )
+        {
+            std::fill( m_line.begin(), m_line.end(), 0.f );
+            for ( std::uint32_t k = 0; k < m_lines.count[y]; ++k )
+            {
+                const auto l = m_lines.first[y] + k;
+                if ( l >= offset_y && l < offset_y + src.height() )
+                    _accumulate( src.line( l - offset_y ), m_lines.weights[ m_lines.offset[y] + k ], m_line.data() + offset_x, src.width() );
+            }
+
+            auto* out = dst.line( y );
+            for ( std::size_t x = 0; x < target_width(); ++x )
+            {
+                const float* in = m_line.data() + m_columns.first[x];
+                const float* w = m_columns.weights.data() + m_columns.offset[x];
+                auto sum = 0.f;
+                for ( std::uint32_t k = 0; k < m_columns.count[x]; ++k )
+                    sum += w[k] * in[k];
+                out[x] = static_cast<T>( saturate( sum + round ) );
+            }
+        }
+    }
+
+    // acc += weight * in, on width pixels
+    template<typename T>
+    static void _accumulate( const T* in, float weight, float* acc, std::size_t width )
+    {
+        for ( std::size_t x = 0; x < width; ++x )
+            acc[x] += weight * in[x];
+    }
+
+    static void _accumulate( const float* in, float weight, float* acc, std::size_t width )
+    {
+        std::size_t x = 0;
+#if defined(TINYMAGE_USE_AVX2)
+        const auto w8 = _mm256_set1_ps( weight );
+        for ( ; x + 8 <= width; x += 8 )
+            _mm256_storeu_ps( acc + x, _mm256_add_ps( _mm256_loadu_ps( acc + x ), _mm256_mul_ps( w8, _mm256_loadu_ps( in + x ) ) ) );
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        const auto w4 = _mm_set1_ps( weight );
+        for ( ; x + 4 <= width; x += 4 )
+            _mm_storeu_ps( acc + x, _mm_add_ps( _mm_loadu_ps( acc + x ), _mm_mul_ps( w4, _mm_loadu_ps( in + x ) ) ) );
+#endif
+        for ( ; x < width; ++x )
+            acc[x] += weight * in[x];
+    }
+
+    // 8 bits pixels are widened to float before the multiply-add
+    static void _accumulate( const unsigned char* in, float weight, float* acc, std::size_t width )
+    {
+        std::size_t x = 0;
+#if defined(TINYMAGE_USE_AVX2)
+        const auto w8 = _mm256_set1_ps( weight );
+        for ( ; x + 8 <= width; x += 8 )
+        {
+            const auto val = _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( in + x ) ) ) );
+            _mm256_storeu_ps( acc + x, _mm256_add_ps( _mm256_loadu_ps( acc + x ), _mm256_mul_ps( w8, val ) ) );
+        }
+#endif
+#if defined(TINYMAGE_USE_SSE)
+        const auto zero = _mm_setzero_si128();
+        const auto w4 = _mm_set1_ps( weight );
+        for ( ; x + 16 <= width; x += 16 )
+        {
+            const auto val = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + x ) );
+            const __m128i words[2] = { _mm_unpacklo_epi8( val, zero ), _mm_unpackhi_epi8( val, zero ) };
+            for ( std::size_t i = 0; i < 4; ++i )
+            {
+                const auto dwords = ( i % 2 == 0 ) ? _mm_unpacklo_epi16( words[i/2], zero ) : _mm_unpackhi_epi16( words[i/2], zero );
+                auto* out = acc + x + 4 * i;
+                _mm_storeu_ps( out, _mm_add_ps( _mm_loadu_ps( out ), _mm_mul_ps( w4, _mm_cvtepi32_ps( dwords ) ) ) );
+            }
+        }
+#endif
+        for ( ; x < width; ++x )
+            acc[x] += weight * in[x];
+    }
+
+private:
+    std::size_t m_width;
+    std::size_t m_height;
+    axis_t m_columns;
+    axis_t m_lines;
+    mutable std::vector<float> m_line;
+};
+
+// resamplers of already met ( source size, target size ) pairs
+// -> not thread safe, returned references stay valid for the cache lifetime
+class tinymage_resampler_cache final
+{
+public:
+    const tinymage_resampler& get( std::size_t sx, std::size_t sy, std::size_t nsx, std::size_t nsy )
+    {
+        key_t key{ sx, sy, nsx, nsy };
+
+        auto it = m_resamplers.find( key );
+        if ( it == m_resamplers.end() )
+            it = m_resamplers.emplace( key, tinymage_resampler( sx, sy, nsx, nsy ) ).first;
+        return it->second;
+    }
+
+    std::size_t size() const { return m_resamplers.size(); }
+    void clear() { m_resamplers.clear(); }
+
+private:
+    using key_t = std::tuple<std::size_t, std::size_t, std::size_t, std::size_t>;
+
+    std::map<key_t, tinymage_resampler> m_resamplers;
+};
+
+// summed area table of an image, built in one pass and accumulated in double
+// -> any rectangle sum is answered in O(1), any ROI projection in O(1) per output value
+// -> rectangles are [startx,stopx[ x [starty,stopy[, as for crop views
+// -> the table itself is allocated by Alloc, which may be a frame arena allocator
+template<typename Alloc = std::allocator<double>>
+class tinymage_integral final
+{
+public:
+    template<typename T>
+    explicit tinymage_integral( const tinymage_view<T>& src, const Alloc& alloc = Alloc() )
+        : m_width{ src.width() }, m_height{ src.height() }, m_sums( ( m_width + 1 ) * ( m_height + 1 ), 0., alloc )
+    {
+        // first line and first column of the table stay zero
+        for ( std::size_t y = 0; y < m_height; ++y )
+        {
+            const T* in = src.line( y );
+            const double* prev = m_sums.data() + ( m_width + 1 ) * y;
+            double* cur = m_sums.data() + ( m_width + 1 ) * ( y + 1 );
+
+            auto line_sum = 0.;
+            for ( std::size_t x = 0; x < m_width; ++x )
+            {
+                line_sum += in[x];
+                cur[x+1] = prev[x+1] + line_sum;
+            }
+        }
+    }
+
+    template<typename T, typename A>
+    explicit tinymage_integral( const tinymage<T,A>& src, const Alloc& alloc = Alloc() ) : tinymage_integral( src.view(), alloc ) {}
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+
+    double sum( std::size_t startx, std::size_t starty, std::size_t stopx, std::size_t stopy ) const
+    {
+        assert( startx <= stopx && stopx <= m_width );
+        assert( starty <= stopy && stopy <= m_height );
+
+        return _at( stopx, stopy ) - _at( startx, stopy ) - _at( stopx, starty ) + _at( startx, starty );
+    }
+
+    double sum() const
+    {
+        return _at( m_width, m_height );
+    }
+
+    // sum of each ROI line, as tinymage_view::line_sums on the ROI crop
+    template<typename A = std::allocator<float>>
+    tinymage<float,A> line_sums( std::size_t startx, std::size_t starty, std::size_t stopx, std::size_t stopy, const A& alloc = A() ) const
+    {
+        tinymage<float,A> output( 1, stopy - starty, 0.f, alloc );
+        for ( auto y = starty; y < stopy; ++y )
+            output[y-starty] = static_cast<float>( sum( startx, y, stopx, y+1 ) );
+        return output;
+    }
+
+    tinymage<float> line_sums() const
+    {
+        return line_sums( 0, 0, m_width, m_height );
+    }
+
+    // sum of each ROI column, as tinymage_view::row_sums on the ROI crop
+    template<typename A = std::allocator<float>>
+    tinymage<float,A> row_sums( std::size_t startx, std::size_t starty, std::size_t stopx, std::size_t stopy, const A& alloc = A() ) const
+    {
+        tinymage<float,A> output( stopx - startx, 1, 0.f, alloc );
+        for ( auto x = startx; x < stopx; ++x )
+            output[x-startx] = static_cast<float>( sum( x, starty, x+1, stopy ) );
+        return output;
+    }
+
+    tinymage<float> row_sums() const
+    {
+        return row_sums( 0, 0, m_width, m_height );
+    }
+
+private:
+
+    double _at( std::size_t x, std::size_t y ) const
+    {
+        return m_sums[ x + ( m_width + 1 ) * y ];
+    }
+
+private:
+    std::size_t m_width;
+    std::size_t m_height;
+    std::vector<double,Alloc> m_sums;
+};
+
+// monotonic memory arena, allocations are only released all at once by reset()
+// -> blocks are kept across resets, so a reset arena serves the same requests without any heap allocation
+// -> not thread safe, memory handed out must not be used anymore after reset()
+class tinymage_arena final
+{
+public:
+    explicit tinymage_arena( std::size_t block_size = 1 << 20 ) : m_block_size{ block_size }, m_current{ 0 }, m_offset{ 0 } {}
+
+    tinymage_arena( const tinymage_arena& ) = delete;
+    tinymage_arena& operator=( const tinymage_arena& ) = delete;
+
+    void* allocate( std::size_t bytes, std::size_t alignment )
+    {
+        // first fit in the current block or in the next ones, a new block is only created when none fits
+        for ( ; m_current < m_blocks.size(); ++m_current, m_offset = 0 )
+        {
+            auto& block = m_blocks[m_current];
+            const auto base = reinterpret_cast<std::uintptr_t>( block.data.get() );
+            const auto start = ( base + m_offset + alignment - 1 ) / alignment * alignment - base;
+            if ( start + bytes <= block.size )
+            {
+                m_offset = start + bytes;
+                return block.data.get() + start;
+            }
+        }
+
+        const auto size = std::max( m_block_size, bytes + alignment );
+        m_blocks.push_back( { std::unique_ptr<char[]>( new char[size] ), size } );
+        m_offset = 0;
+        return allocate( bytes, alignment );
+    }
+
+    // all allocations are released, memory blocks are kept for reuse
+    void reset()
+    {
+        m_current = 0;
+        m_offset = 0;
+    }
+
+    // total size of the memory blocks owned by the arena
+    std::size_t capacity() const
+    {
+        return std::accumulate( m_blocks.begin(), m_blocks.end(), std::size_t(0),
+            []( std::size_t sum, const block_t& block ) { return sum + block.size; } );
+    }
+
+private:
+
+    struct block_t
+    {
+        std::unique_ptr<char[]> data;
+        std::size_t size;
+    };
+
+    std::size_t m_block_size;
+    std::vector<block_t> m_blocks;
+    std::size_t m_current;
+    std::size_t m_offset;
+};
+
+// stateful allocator drawing from a tinymage_arena, deallocation is a no-op
+template<typename T>
+class tinymage_arena_allocator
+{
+    template <typename U>
+    friend class tinymage_arena_allocator;
+
+public:
+    using value_type = T;
+
+    // moved images keep their buffer, whatever arena the destination used
+    using propagate_on_container_move_assignment = std::true_type;
+
+    explicit tinymage_arena_allocator( tinymage_arena& arena ) noexcept : m_arena{ &arena } {}
+
+    template<typename U>
+    tinymage_arena_allocator( const tinymage_arena_allocator<U>& other ) noexcept : m_arena{ other.m_arena } {}
+
+    T* allocate( std::size_t n )
+    {
+        return static_cast<T*>( m_arena->allocate( n * sizeof(T), alignof(T) ) );
+    }
+
+    void deallocate( T*, std::size_t ) noexcept {}
+
+    template<typename U>
+    bool operator==( const tinymage_arena_allocator<U>& other ) const noexcept { return m_arena == other.m_arena; }
+    template<typename U>
+    bool operator!=( const tinymage_arena_allocator<U>& other ) const noexcept { return m_arena != other.m_arena; }
+
+private:
+    tinymage_arena* m_arena;
+};
+
+// image whose pixels live in a tinymage_arena
+template<typename T=float>
+using tinymage_arena_image = tinymage<T,tinymage_arena_allocator<T>>;
+
+// heap allocator returning Align bytes aligned blocks
+// -> its alignment member also makes tinymage pad its lines to a multiple of Align bytes,
+// -> so that every line starts aligned for SIMD loads and stores
+template<typename T, std::size_t Align = 64>
+class tinymage_aligned_allocator
+{
+    static_assert( Align >= alignof(void*) && ( Align & ( Align - 1 ) ) == 0, "alignment must be a power of two" );
+
+public:
+    using value_type = T;
+
+    static constexpr std::size_t alignment = Align;
+
+    template<typename U>
+    struct rebind { using other = tinymage_aligned_allocator<U,Align>; };
+
+    tinymage_aligned_allocator() noexcept = default;
+
+    template<typename U>
+    tinymage_aligned_allocator( const tinymage_aligned_allocator<U,Align>& ) noexcept {}
+
+    T* allocate( std::size_t n )
+    {
+        // the raw block address is stored just before the aligned block
+        auto raw = static_cast<char*>( ::operator new( n * sizeof(T) + Align ) );
+        const auto base = reinterpret_cast<std::uintptr_t>( raw + sizeof(void*) );
+        auto aligned = raw + ( ( base + Align - 1 ) / Align * Align - reinterpret_cast<std::uintptr_t>( raw ) );
+        reinterpret_cast<void**>( aligned )[-1] = raw;
+        return reinterpret_cast<T*>( aligned );
+    }
+
+    void deallocate( T* p, std::size_t ) noexcept
+    {
+        ::operator delete( reinterpret_cast<void**>( p )[-1] );
+    }
+
+    template<typename U>
+    bool operator==( const tinymage_aligned_allocator<U,Align>& ) const noexcept { return true; }
+    template<typename U>
+    bool operator!=( const tinymage_aligned_allocator<U,Align>& ) const noexcept { return false; }
+};
+
+// image whose lines all start on a 64 bytes boundary, its stride() being padded accordingly
+template<typename T=float>
+using tinymage_aligned = tinymage<T,tinymage_aligned_allocator<T>>;
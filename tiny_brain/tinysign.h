@@ -27,37 +27,51 @@ THE SOFTWARE.
 #include "tiny_brain/tinymage.h"
 
 #include <map>
-#include <set>
 
 // 'sign' localization helper class
 // NOTE : what I call 'sign' is meant to be a white rectangular paper sheet with digits written on it
 class tinysign
 {
 public:
-    tinysign( size_t sx, size_t sy ) : m_input( sx, sy ) {}
+    // coarse_level > 0 enables the coarse-to-fine mode : candidates are detected on the pyramid level of that index
+    // ( 2^coarse_level downsampling ), then their bounds are refined at full resolution inside each candidate region only
+    // smooth_radius > 0 box filters the frames before thresholding, for noisy sources such as webcams
+    tinysign( size_t sx, size_t sy, size_t coarse_level = 0, size_t smooth_radius = 0 )
+        : m_input( sx, sy ), m_coarse_level{ coarse_level }, m_smooth_radius{ smooth_radius } {}
 
     void locate( const tinymage<float>& img_in )
     {
-		m_input = img_in.get_auto_threshold();
-        m_input.display();
-
-		m_bounds = _blob_detect( m_input );
         m_filtered_bounds.clear();
 
-		for ( const auto& _bounds : m_bounds )
-		{
-    		auto w = _bounds.second[2]-_bounds.second[0];
-    		auto h = _bounds.second[3]-_bounds.second[1];
-    		auto aspect_ratio = static_cast<float>(w)/h;
-    		auto fill_ratio = static_cast<float>(_bounds.second[4])/(w*h);
+        // running sums box filter, its cost does not depend on the radius
+        if ( m_smooth_radius > 0 )
+            img_in.view().box_blur_into( m_smoothed, m_smooth_radius, m_smooth_radius, tinymage_types::border_policy::clamp, tinymage_types::auto_threads );
+        const auto& frame = m_smooth_radius > 0 ? m_smoothed : img_in;
+
+        if ( m_coarse_level > 0 )
+        {
+            _locate_coarse_to_fine( frame );
+        }
+        else
+        {
+		    // full frames, split across the hardware threads
+		    const auto thresh = static_cast<float>( frame.view().get_auto_threshold_value( tinymage_types::threshold_method::isodata, tinymage_types::auto_threads ) );
+		    frame.lazy().threshold( thresh ).eval_into( m_input, tinymage_types::auto_threads );
+            m_input.display();
+
+		    // blobs are labeled on runs encoded straight from the gray image
+		    m_bounds = _blob_detect( tinymage_rle( frame.view(), thresh, tinymage_types::auto_threads ) );
 
-    		if ( _bounds.second[4] < 2500 || aspect_ratio < 1.25f || fill_ratio < 0.5f )
-        		continue;
+		    for ( const auto& _bounds : m_bounds )
+		    {
+    		    if ( !_is_sign( _bounds.second, g_min_sign_area ) )
+        		    continue;
 
-    		//auto cropped = img.get_crop(_blob.second[0],_blob.second[1],_blob.second[2],_blob.second[3]);
+    		    //auto cropped = img.get_crop(_blob.second[0],_blob.second[1],_blob.second[2],_blob.second[3]);
 
-            m_filtered_bounds.emplace_back( std::vector<size_t>{ _bounds.second[0], _bounds.second[1], _bounds.second[2], _bounds.second[3], _bounds.second[4] } );
-		}
+                m_filtered_bounds.emplace_back( _bounds.second );
+		    }
+        }
 
         for ( const auto& _bounds : m_filtered_bounds )
         {
@@ -73,6 +87,7 @@ public:
     {
         return m_filtered_bounds.front();
     }
+    // in coarse-to-fine mode, the thresholded image is the coarse level one
     const tinymage<float>& get_sign_thresh()
     {
         return m_input; // TODO:  really usefull to keep thresholded image?
@@ -80,10 +95,11 @@ public:
 
     void extract( const tinymage<float>& img_in, const std::vector<size_t>& sign_bounds )
     {
-        tinymage<float> cropped = img_in.get_crop( sign_bounds[0], sign_bounds[1], sign_bounds[2], sign_bounds[3] );
-
-    	auto thresh_cropped = cropped.get_auto_threshold();
+        auto cropped = img_in.get_crop_view( sign_bounds[0], sign_bounds[1], sign_bounds[2], sign_bounds[3] );
 
+    	// packed 1 bit per pixel, projections are popcounts of the mask words
+    	const auto thresh = cropped.get_auto_threshold_value( tinymage_types::threshold_method::isodata, tinymage_types::auto_threads );
+    	const tinymage_binary thresh_cropped( cropped, static_cast<float>( thresh ), tinymage_types::auto_threads );
     	auto line_sums = thresh_cropped.line_sums();
     	auto row_sums = thresh_cropped.row_sums();
 
@@ -128,7 +144,8 @@ public:
         std::cout << "warping mode : " << std::string( left ? "left" : "right" ) << std::endl;
 
     	tinymage_types::quad_coord_t outcoord{ {0U,0U}, {w,0U}, {w,h}, {0U,h} };
-    	m_warped = cropped.get_warp( incoord, outcoord );
+    	// scratch images are members, their buffers are reused from frame to frame
+    	cropped.warp_into( m_warped, incoord, outcoord, tinymage_types::auto_threads );
     	m_warped.remove_border( 2 );
     	m_warped.display();
     }
@@ -139,9 +156,17 @@ public:
 
 private:
 
+    static constexpr size_t g_min_sign_area = 2500;
+
     tinymage<float> m_input;
     tinymage<float> m_warped;
 
+    size_t m_coarse_level;
+    tinymage_pyramid<float> m_pyramid;
+
+    size_t m_smooth_radius;
+    tinymage<float> m_smoothed;
+
     using bounds_t = std::map<size_t,std::vector<size_t>>;
     bounds_t m_bounds;
     using filt_bounds_t = std::vector<std::vector<size_t>>;
@@ -149,123 +174,69 @@ private:
 
 private:
 
-     // Given image dimensions and a raw string of grayscale pixels, detects blobs
-     // in the "image" Uses two-pass connected component algorithm described here:
-     // http://en.wikipedia.org/wiki/Blob_extraction#Two-pass (Jan 2011).
-    template<typename T>
-    std::map<size_t,std::vector<size_t>> _blob_detect( const tinymage<T> image )
+    // bounds are { x0, y0, x1, y1, area }, the rectangle being inclusive
+    static bool _is_sign( const std::vector<size_t>& bounds, size_t min_area )
     {
-        std::map<size_t,std::set<size_t>> groups;
-
-        /*
-        * Pass one: provisionally label each non-background cell with a label.
-        */
+        auto w = bounds[2]-bounds[0];
+        auto h = bounds[3]-bounds[1];
+        auto aspect_ratio = static_cast<float>(w)/h;
+        auto fill_ratio = static_cast<float>(bounds[4])/(w*h);
 
-        // an array to hold the labels
-        std::vector<size_t> labels( image.size() );
-        std::set<size_t> groupset;
+        return !( bounds[4] < min_area || aspect_ratio < 1.25f || fill_ratio < 0.5f );
+    }
 
-        auto w = image.width();
-        auto h = image.height();
+    void _locate_coarse_to_fine( const tinymage<float>& img_in )
+    {
+        // box filtering keeps the white sheet dynamic, so the coarse threshold applies to the full resolution too
+        m_pyramid.build( img_in.view(), m_coarse_level, tinymage_types::pyramid_filter::box, tinymage_types::auto_threads );
+        const auto level = m_pyramid.size() - 1;
+        const auto scale = m_pyramid.scale( level );
+        const auto coarse = m_pyramid.level( level );
+
+        const auto thresh = static_cast<float>( coarse.get_auto_threshold_value( tinymage_types::threshold_method::isodata ) );
+        coarse.lazy().threshold( thresh ).eval_into( m_input );
+        m_input.display();
 
-        size_t blobs = 0;
+        m_bounds = _blob_detect( tinymage_rle( coarse, thresh ) );
 
-        tinymage_forXY( image, x, y )
+        for ( const auto& _bounds : m_bounds )
         {
-            // offset in the image for a given (x, y) pixel
-            auto off = ( y * w ) + x;
+            const auto& coarse_bounds = _bounds.second;
+            if ( !_is_sign( coarse_bounds, std::max( size_t(1), g_min_sign_area / ( scale * scale ) ) ) )
+                continue;
 
-            if ( image.c_at(x,y) < 1 ) // TODO : parameters?
-            {
-                // dark pixel means it's part of the background
-                labels[off] = 0;
-            }
-            else
-            {
-                // light pixel means it's part of a blob
-
-                size_t label;
-
-                if ( y > 0 && labels[off - w] > 0 && x > 0 && labels[off - 1] > 0 )
-                {
-                    // pixels up and left are both known blobs
-                    label = labels[off - w];
-
-                    if( label != labels[off - 1] )
-                    {
-                        // associate the two labels
-                        groups[label].insert( labels[off - 1] );
-                        groups[labels[off - 1]].insert( label );
-
-                        // unify the sets - make sure they all have the same items
-
-                        groupset = groups[label];
-
-                        for( auto groupiter = groupset.begin(); groupiter != groupset.end(); groupiter++ )
-                            groups[labels[off - 1]].insert( *groupiter );
-
-                        groupset = groups[labels[off - 1]];
-
-                        for( auto groupiter = groupset.begin(); groupiter != groupset.end(); groupiter++ )
-                            groups[label].insert( *groupiter );
-                    }
-                }
-                else if ( y > 0 && labels[off - w] > 0 )
-                {
-                    // pixel one row up is a known blob
-                    label = labels[off - w];
-                }
-                else if ( x > 0 && labels[off - 1] > 0 )
-                {
-                    // pixel to the left is a known blob
-                    label = labels[off - 1];
-                }
-                else
-                {
-                    // a new blob!
-                    blobs++;
-                    label = blobs;
-
-                    groups[label].insert( label );
-                }
-
-                labels[off] = label;
-            }
-        }
+            // full resolution candidate region, with one coarse pixel margin
+            const auto startx = ( coarse_bounds[0] > 0 ? coarse_bounds[0] - 1 : 0 ) * scale;
+            const auto starty = ( coarse_bounds[1] > 0 ? coarse_bounds[1] - 1 : 0 ) * scale;
+            const auto stopx = std::min( ( coarse_bounds[2] + 2 ) * scale, img_in.width() );
+            const auto stopy = std::min( ( coarse_bounds[3] + 2 ) * scale, img_in.height() );
 
-		/*
-        * Pass two: merge labels of connected components, collect bboxes along the way.
-        */
+            const tinymage_rle region( img_in.get_crop_view( startx, starty, stopx, stopy ), thresh );
 
-        std::map<size_t,std::vector<size_t>> bounds;
-
-        for ( auto y = size_t(0); y < h; y++ )
-        {
-            for ( auto x = size_t(0); x < w; x++ )
+            // the sign is the largest sign shaped blob of its region
+            std::vector<size_t> bounds;
+            for ( const auto& _fine_bounds : _blob_detect( region ) )
             {
-                // offset in the string for a given (x, y) pixel
-                auto off = ( y * w ) + x;
-
-                if ( labels[off] > 0 )
-                {
-                    size_t label = *(groups[labels[off]].begin());
-
-                    if ( bounds.find( label ) == bounds.end() )
-                        bounds[label] = { x, y, x, y, 1 };
-                    else
-                    {
-                        auto& _bounds = bounds[label];
-
-                        _bounds[0] = std::min( x, _bounds[0] );
-                        _bounds[1] = std::min( y, _bounds[1] );
-                        _bounds[2] = std::max( x, _bounds[2] );
-                        _bounds[3] = std::max( y, _bounds[3] );
-                        _bounds[4] += 1;
-                    }
-                }
+                const auto& b = _fine_bounds.second;
+                if ( _is_sign( b, g_min_sign_area ) && ( bounds.empty() || b[4] > bounds[4] ) )
+                    bounds = { b[0] + startx, b[1] + starty, b[2] + startx, b[3] + starty, b[4] };
             }
+            if ( !bounds.empty() )
+                m_filtered_bounds.emplace_back( std::move( bounds ) );
         }
+    }
+
+    // detects the 4-connected blobs of a thresholded mask, keyed from 1 in the raster order of their first pixel
+    // -> two-pass connected component labeling done on the mask runs instead of its pixels, see
+    //    http://en.wikipedia.org/wiki/Blob_extraction#Two-pass (Jan 2011).
+    static bounds_t _blob_detect( const tinymage_rle& mask )
+    {
+        bounds_t bounds;
+
+        size_t label = 0;
+        for ( const auto& _blob : mask.get_blobs() )
+            bounds[++label] = { _blob.x0, _blob.y0, _blob.x1, _blob.y1, _blob.area };
 
-       return bounds;
+        return bounds;
     }
 };
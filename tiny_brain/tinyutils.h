@@ -24,8 +24,17 @@ THE SOFTWARE.
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
 #include <utility>
+#include <vector>
 
 class tinyutils
 {
@@ -37,6 +46,220 @@ public:
         return sequence_build( sequence_add<-static_cast<int>(A)>( std::make_integer_sequence<int,2*A+1>{} ) );
     }
 
+    // fixed set of worker threads, created once and reused by every parallel_for call
+    class thread_pool
+    {
+    public:
+        explicit thread_pool( std::size_t nb_workers ) : m_stop{ false }
+        {
+            for ( std::size_t i = 0; i < nb_workers; ++i )
+                m_workers.emplace_back( [this]() { _run(); } );
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            for ( auto& worker : m_workers )
+                worker.join();
+        }
+
+        thread_pool( const thread_pool& ) = delete;
+        thread_pool& operator=( const thread_pool& ) = delete;
+
+        std::size_t size() const { return m_workers.size(); }
+
+        // tasks must not throw, an escaping exception would terminate the worker thread
+        // -> parallel_for tasks catch and forward theirs to the caller
+        void push( std::function<void()> task )
+        {
+            {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                m_tasks.push( std::move( task ) );
+            }
+            m_cv.notify_one();
+        }
+
+        // true if the calling thread belongs to a pool
+        static bool is_worker()
+        {
+            return _worker_flag();
+        }
+
+        // pool shared by the whole process, one worker less than the hardware threads as the caller works too
+        static thread_pool& shared()
+        {
+            static thread_pool pool( std::max( std::size_t(1), hardware_tasks() - 1 ) );
+            return pool;
+        }
+
+    private:
+
+        void _run()
+        {
+            _worker_flag() = true;
+            for (;;)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock( m_mutex );
+                    m_cv.wait( lock, [this]() { return m_stop || !m_tasks.empty(); } );
+                    if ( m_tasks.empty() )
+                        return;
+                    task = std::move( m_tasks.front() );
+                    m_tasks.pop();
+                }
+                task();
+            }
+        }
+
+        static bool& _worker_flag()
+        {
+            thread_local bool flag = false;
+            return flag;
+        }
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+    };
+
+    static std::size_t popcount( std::uint64_t word )
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>( __builtin_popcountll( word ) );
+#else
+        // parallel bits count
+        word = word - ( ( word >> 1 ) & 0x5555555555555555ULL );
+        word = ( word & 0x3333333333333333ULL ) + ( ( word >> 2 ) & 0x3333333333333333ULL );
+        word = ( word + ( word >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+        return static_cast<std::size_t>( ( word * 0x0101010101010101ULL ) >> 56 );
+#endif
+    }
+
+    // index of the lowest set bit, word must not be 0
+    static std::size_t count_trailing_zeros( std::uint64_t word )
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>( __builtin_ctzll( word ) );
+#else
+        return popcount( ( word & ( ~word + 1 ) ) - 1 );
+#endif
+    }
+
+    // number of zero bits above the highest set bit, word must not be 0
+    static std::size_t count_leading_zeros( std::uint64_t word )
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>( __builtin_clzll( word ) );
+#else
+        // all the bits below the highest set one are set, then counted
+        word |= word >> 1;
+        word |= word >> 2;
+        word |= word >> 4;
+        word |= word >> 8;
+        word |= word >> 16;
+        word |= word >> 32;
+        return 64 - popcount( word );
+#endif
+    }
+
+    static std::size_t hardware_tasks()
+    {
+        return std::max( 1U, std::thread::hardware_concurrency() );
+    }
+
+    // splits [0...count) in contiguous bands, processed concurrently by up to nb_tasks threads of the shared pool
+    // -> func( start, stop ) is called once per band, the calling thread processing the first one
+    // -> nb_tasks = 0 uses all hardware threads, nested calls from a pool thread run serially
+    // -> the first exception thrown by a band is rethrown once every pushed band is done
+    template<typename Func>
+    static void parallel_for( std::size_t count, std::size_t nb_tasks, Func func )
+    {
+#ifdef CNN_SINGLE_THREAD
+        nb_tasks = 1;
+#endif
+        if ( nb_tasks == 0 )
+            nb_tasks = hardware_tasks();
+        if ( thread_pool::is_worker() )
+            nb_tasks = 1;
+        nb_tasks = std::max( std::size_t(1), std::min( nb_tasks, count ) );
+
+        if ( nb_tasks == 1 )
+        {
+            func( std::size_t(0), count );
+            return;
+        }
+
+        const auto band = ( count + nb_tasks - 1 ) / nb_tasks;
+
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+        std::size_t pending = 0;
+        std::exception_ptr error;
+
+        // queued bands reference this frame, so it is left only once they are all done, even when throwing
+        // -> pending counts the bands actually pushed, a failed push leaving the remaining ones out
+        auto& pool = thread_pool::shared();
+        try
+        {
+            for ( auto start = band; start < count; start += band )
+            {
+                const auto stop = std::min( start + band, count );
+                {
+                    std::lock_guard<std::mutex> lock( done_mutex );
+                    ++pending;
+                }
+                try
+                {
+                    pool.push( [&,start,stop]()
+                        {
+                            std::exception_ptr band_error;
+                            try
+                            {
+                                func( start, stop );
+                            }
+                            catch ( ... )
+                            {
+                                band_error = std::current_exception();
+                            }
+                            // notified under lock, so the waiting caller cannot return before notify_one is done
+                            std::lock_guard<std::mutex> lock( done_mutex );
+                            if ( band_error && !error )
+                                error = band_error;
+                            --pending;
+                            done_cv.notify_one();
+                        });
+                }
+                catch ( ... )
+                {
+                    std::lock_guard<std::mutex> lock( done_mutex );
+                    --pending;
+                    throw;
+                }
+            }
+
+            func( std::size_t(0), band );
+        }
+        catch ( ... )
+        {
+            std::lock_guard<std::mutex> lock( done_mutex );
+            if ( !error )
+                error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock( done_mutex );
+        done_cv.wait( lock, [&]() { return pending == 0; } );
+        if ( error )
+            std::rethrow_exception( error );
+    }
+
 private:
 
     template<typename T, T... I>